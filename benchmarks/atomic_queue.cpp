@@ -0,0 +1,221 @@
+// benchmarks/atomic_queue.cpp: throughput of AtomicQueue and ThreadPool under
+// contention. Several producer/consumer pairs each use their own queue, with
+// the queues stored next to each other; with the old unpadded layout,
+// neighbouring queues shared cache lines, so pairs which never touch each
+// other's data still slowed each other down. PackedQueue reproduces that
+// layout for comparison. Likewise, PackedPool is a ThreadPool with its old
+// member layout, where the task queue, the notifier, the idle counter, and the
+// flags read by every AddTask all shared cache lines.
+//
+// The difference only shows up when the pairs actually run on different
+// cores, so run this on an otherwise idle machine with several of them.
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2018-2019 by Joyz Inc of Tokyo, Japan (author: Charles Hussong) //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "bench.hpp"
+
+#include "atomic_containers.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// The member layout AtomicQueue had before it was aligned to cache lines.
+template<class T>
+class PackedQueue {
+  public:
+    void push(T value) {
+        {
+            std::lock_guard<std::mutex> lock(data_mutex);
+            data.push(std::move(value));
+        }
+        data_cv.notify_one();
+    }
+
+    T pop() {
+        std::unique_lock<std::mutex> lock(data_mutex);
+        data_cv.wait(lock, [this](){ return !data.empty(); });
+        T output = std::move(data.front());
+        data.pop();
+        return output;
+    }
+
+  private:
+    std::queue<T> data;
+    std::mutex data_mutex;
+    std::condition_variable data_cv;
+};
+
+// The member layout ThreadPool had before its members were grouped onto
+// separate cache lines, with just enough of its interface to run tasks.
+class PackedPool {
+  public:
+    explicit PackedPool(std::size_t threadCount):
+            finished(false), noMoreTasks(false), waiting(0) {
+        for (std::size_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back(&PackedPool::WaitForTask, this);
+        }
+    }
+
+    ~PackedPool() {
+        {
+            std::lock_guard<std::mutex> taskLock(taskMutex);
+            finished = true;
+        }
+        notifier.notify_all();
+        for (auto& thread : threads) thread.join();
+    }
+
+    template<class Callable>
+    auto AddTask(Callable&& newTask) {
+        using PTask = std::packaged_task<
+                typename std::result_of<Callable()>::type()>;
+        PTask packaged(std::forward<Callable>(newTask));
+        auto futureResult = packaged.get_future();
+        if (finished) throw std::logic_error("PackedPool is finished");
+        {
+            std::lock_guard<std::mutex> taskLock(taskMutex);
+            tasks.push(std::make_unique<Task<PTask>>(std::move(packaged)));
+        }
+        notifier.notify_one();
+        return futureResult;
+    }
+
+  private:
+    class AbstractTask {
+      public:
+        virtual ~AbstractTask() = default;
+        virtual void operator()() = 0;
+    };
+
+    template<class Callable>
+    class Task : public AbstractTask {
+      public:
+        explicit Task(Callable&& func): func(std::move(func)) {}
+        void operator()() override { func(); }
+      private:
+        Callable func;
+    };
+
+    std::mutex taskMutex;
+    std::condition_variable notifier;
+    std::queue<std::unique_ptr<AbstractTask>> tasks;
+
+    std::atomic<bool> finished;
+    std::atomic<bool> noMoreTasks;
+    std::atomic<std::size_t> waiting;
+
+    std::mutex threadMutex;
+    std::vector<std::thread> threads;
+
+    void WaitForTask() {
+        std::unique_ptr<AbstractTask> myTask;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> taskLock(taskMutex);
+                if (tasks.empty()) {
+                    if (finished) break;
+                    ++waiting;
+                    notifier.wait(taskLock, [this]{
+                        return !tasks.empty() || finished || noMoreTasks;
+                    });
+                    --waiting;
+                }
+                if (noMoreTasks || tasks.empty()) break;
+                myTask = std::move(tasks.front());
+                tasks.pop();
+            }
+            (*myTask)();
+        }
+    }
+};
+
+template<class Queue>
+Bench::Timing MeasurePairs(std::size_t pairs) {
+    return Bench::Measure([pairs](std::size_t items){
+        // adjacent in memory, like an array of queues owned by a router
+        auto queues = std::make_unique<Queue[]>(pairs);
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < pairs; ++p) {
+            Queue& queue = queues[p];
+            threads.emplace_back([&queue, items](){
+                for (std::size_t i = 0; i < items; ++i) queue.push(int(i));
+            });
+            threads.emplace_back([&queue, items](){
+                long total = 0;
+                for (std::size_t i = 0; i < items; ++i) total += queue.pop();
+                Bench::DoNotOptimize(total);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    });
+}
+
+void BenchmarkQueues() {
+    Bench::PrintTitle("producer/consumer pairs on adjacent queues "
+                      "(time per item per pair)");
+    Bench::PrintRow("", "AtomicQueue", "PackedQueue");
+
+    std::size_t cores = std::max(2u, std::thread::hardware_concurrency());
+    for (std::size_t pairs = 1; pairs <= cores/2; pairs *= 2) {
+        auto padded = MeasurePairs<LCH::AtomicQueue<int>>(pairs);
+        auto packed = MeasurePairs<PackedQueue<int>>(pairs);
+        Bench::PrintRow(std::to_string(pairs) + " pair(s)",
+                        Bench::Format(padded.NanosecondsPer(), "ns"),
+                        Bench::Format(packed.NanosecondsPer(), "ns"));
+    }
+}
+
+template<class Pool>
+Bench::Timing MeasurePool(std::size_t threads) {
+    Pool pool(threads);
+    return Bench::Measure([&pool](std::size_t tasks){
+        std::vector<std::future<std::size_t>> results;
+        results.reserve(tasks);
+        for (std::size_t i = 0; i < tasks; ++i) {
+            results.push_back(pool.AddTask([i](){ return i; }));
+        }
+        for (auto& result : results) Bench::DoNotOptimize(result.get());
+    });
+}
+
+void BenchmarkThreadPool() {
+    Bench::PrintTitle("thread pools with trivial tasks (time per task)");
+    Bench::PrintRow("", "ThreadPool", "PackedPool");
+
+    std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t threads = 1; threads <= cores; threads *= 2) {
+        auto padded = MeasurePool<LCH::ThreadPool>(threads);
+        auto packed = MeasurePool<PackedPool>(threads);
+        Bench::PrintRow(std::to_string(threads) + " thread(s)",
+                        Bench::Format(padded.NanosecondsPer(), "ns"),
+                        Bench::Format(packed.NanosecondsPer(), "ns"));
+    }
+}
+
+int main() {
+    BenchmarkQueues();
+    BenchmarkThreadPool();
+    return 0;
+}
@@ -0,0 +1,89 @@
+// benchmarks/bench.hpp: a minimal timing harness shared by the benchmark
+// executables in this directory. A benchmark body is a callable taking a
+// repetition count and doing the measured work that many times; Measure keeps
+// increasing the count until a run takes long enough to time reliably, then
+// reports the time taken per repetition.
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2018-2019 by Joyz Inc of Tokyo, Japan (author: Charles Hussong) //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_BENCH_HPP
+#define LCH_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace Bench {
+
+using Clock = std::chrono::steady_clock;
+
+// Makes the compiler believe value is used, so that the computation producing
+// it can't be optimized away.
+template<typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Timing {
+    std::size_t repetitions;
+    double seconds;
+
+    double NanosecondsPer() const { return 1e9*seconds/repetitions; }
+    double PerSecond() const { return repetitions/seconds; }
+};
+
+template<class Body>
+Timing Measure(Body&& body, double minSeconds = 0.25) {
+    std::size_t repetitions = 1;
+    while (true) {
+        auto start = Clock::now();
+        body(repetitions);
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        if (elapsed.count() >= minSeconds) {
+            return {repetitions, elapsed.count()};
+        }
+        double factor = elapsed.count() > 0 ? 1.2*minSeconds/elapsed.count()
+                                             : 100.0;
+        repetitions = static_cast<std::size_t>(
+                repetitions*std::min(std::max(factor, 2.0), 100.0));
+    }
+}
+
+inline void PrintTitle(const std::string& title) {
+    std::printf("\n%s\n%s\n", title.c_str(), 
+                std::string(title.size(), '-').c_str());
+}
+
+// Prints one line of results: a label followed by any number of columns which
+// have already been formatted.
+template<class... Columns>
+void PrintRow(const std::string& label, const Columns&... columns) {
+    std::printf("%-44s", label.c_str());
+    (std::printf(" %14s", std::string(columns).c_str()), ...);
+    std::printf("\n");
+}
+
+inline std::string Format(double value, const char* unit) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%.4g %s", value, unit);
+    return buffer;
+}
+
+} // namespace Bench
+
+#endif // LCH_BENCH_HPP
@@ -0,0 +1,238 @@
+// benchmarks/levenshtein.cpp: speed of levenshtein_distance across input
+// lengths, alphabets, cost models, and iterator kinds, to show where each of
+// its kernels takes over and to catch regressions in any of them.
+//
+// Each pair is a random text and a copy of it with about one edit in ten, so
+// the common prefix and suffix that get trimmed are short, like in real data.
+// Times are per call; "ns/cell" divides that by the size of the full DP matrix
+// (the product of the lengths), which is what the one-row method visits, so
+// the faster kernels show up as fractions of a nanosecond.
+//
+// The ASCII alphabets are compared as std::string, like most real text, and
+// Japanese as std::u32string; the UTF-8 table below compares the same
+// Japanese text as bytes too.
+//
+// Equal costs with the same integral symbols on both sides go to the
+// bit-parallel kernel; other costs go to the SIMD wavefront once both sides
+// have at least a couple of dozen symbols, and to the one-row method below
+// that or for anything else (e.g. std::list against a std::string of a
+// different symbol type).
+//
+// Pass a maximum length as the only argument to skip the longer inputs.
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "bench.hpp"
+
+#include "levenshtein.hpp"
+#include "levenshtein_utf8.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+const std::vector<std::size_t> lengths{4, 16, 64, 256, 1024, 4096, 10000};
+
+// Lowercase words and spaces, roughly with English letter frequencies.
+std::u32string EnglishLikeText(std::mt19937& rng, std::size_t length) {
+    const std::u32string letters = U"eeeeeeettttaaaaoooiiinnnssshhhrrddllcumwf"
+                                   U"gypbvk      ";
+    std::uniform_int_distribution<std::size_t> pick(0, letters.size() - 1);
+    std::u32string text;
+    for (std::size_t i = 0; i < length; ++i) text.push_back(letters[pick(rng)]);
+    return text;
+}
+
+// Mostly hiragana, with some katakana, kanji, and punctuation; three bytes
+// each in UTF-8.
+std::u32string JapaneseLikeText(std::mt19937& rng, std::size_t length) {
+    std::uniform_int_distribution<int> kind(0, 9);
+    std::uniform_int_distribution<char32_t> hiragana(0x3041, 0x3093);
+    std::uniform_int_distribution<char32_t> katakana(0x30A1, 0x30F3);
+    std::uniform_int_distribution<char32_t> kanji(0x4E00, 0x4FFF);
+    std::u32string text;
+    for (std::size_t i = 0; i < length; ++i) {
+        int k = kind(rng);
+        text.push_back(k < 6 ? hiragana(rng) : k < 8 ? katakana(rng)
+                             : k < 9 ? kanji(rng) : U'、');
+    }
+    return text;
+}
+
+std::u32string DNAText(std::mt19937& rng, std::size_t length) {
+    const std::u32string bases = U"ACGT";
+    std::uniform_int_distribution<std::size_t> pick(0, 3);
+    std::u32string text;
+    for (std::size_t i = 0; i < length; ++i) text.push_back(bases[pick(rng)]);
+    return text;
+}
+
+// A copy of text with about one substitution, insertion, or deletion (taken
+// from text's own symbols) in every ten positions.
+std::u32string Mutated(std::mt19937& rng, const std::u32string& text) {
+    std::uniform_int_distribution<int> roll(0, 29);
+    std::uniform_int_distribution<std::size_t> pick(0, text.size() - 1);
+    std::u32string mutated;
+    for (char32_t c : text) {
+        switch (roll(rng)) {
+          case 0: mutated.push_back(text[pick(rng)]); break;
+          case 1: break;
+          case 2: mutated.push_back(text[pick(rng)]); mutated.push_back(c);
+                  break;
+          default: mutated.push_back(c);
+        }
+    }
+    return mutated;
+}
+
+std::string ToUTF8(const std::u32string& text) {
+    std::string encoded;
+    for (char32_t c : text) {
+        if (c < 0x80) {
+            encoded.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            encoded.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            encoded.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            encoded.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            encoded.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            encoded.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+    return encoded;
+}
+
+// Text as the string type a benchmark compares: UTF-8 bytes or code points.
+void Encode(const std::u32string& text, std::string& encoded) {
+    encoded = ToUTF8(text);
+}
+
+void Encode(const std::u32string& text, std::u32string& encoded) {
+    encoded = text;
+}
+
+// Times distance(), which should compare one pair, and prints it as a row.
+template<class Distance>
+void PrintMeasurement(const std::string& label, std::size_t cells,
+                      const Distance& distance) {
+    auto timing = Bench::Measure([&](std::size_t calls){
+        for (std::size_t i = 0; i < calls; ++i) {
+            Bench::DoNotOptimize(distance());
+        }
+    }, 0.1);
+    Bench::PrintRow(label, Bench::Format(timing.NanosecondsPer(), "ns"),
+                    Bench::Format(timing.NanosecondsPer()/cells, "ns/cell"),
+                    Bench::Format(timing.PerSecond(), "calls/s"));
+}
+
+using Generator = std::u32string (*)(std::mt19937&, std::size_t);
+
+const std::vector<std::pair<std::string, LCH::LevenshteinCosts>> costModels{
+    {"equal costs", {1, 1, 1}}, {"sub 2, ins 1, del 1", {2, 1, 1}}};
+
+template<class Text>
+void BenchmarkAlphabet(const std::string& name, Generator generate,
+                       std::size_t maxLength) {
+    for (const auto& model : costModels) {
+        const LCH::LevenshteinCosts& costs = model.second;
+        Bench::PrintTitle(name + ", " + model.first);
+        Bench::PrintRow("length", "time", "per cell", "rate");
+        std::mt19937 rng(43);
+        for (std::size_t length : lengths) {
+            if (length > maxLength) break;
+            auto a32 = generate(rng, length);
+            Text a;
+            Text b;
+            Encode(a32, a);
+            Encode(Mutated(rng, a32), b);
+            std::size_t cells = std::max<std::size_t>(1, a.size()*b.size());
+            PrintMeasurement(std::to_string(length), cells, [&](){
+                return LCH::levenshtein_distance(a, b, costs);
+            });
+        }
+    }
+}
+
+void BenchmarkUTF8(std::size_t maxLength) {
+    Bench::PrintTitle("Japanese as UTF-8 bytes, decoded, and UTF-32 "
+                      "(equal costs; per cell counts code points)");
+    Bench::PrintRow("length", "time", "per cell", "rate");
+    std::mt19937 rng(430);
+    for (std::size_t length : lengths) {
+        if (length > maxLength) break;
+        auto a = JapaneseLikeText(rng, length);
+        auto b = Mutated(rng, a);
+        std::string a8 = ToUTF8(a);
+        std::string b8 = ToUTF8(b);
+        std::size_t cells = std::max<std::size_t>(1, a.size()*b.size());
+        std::string label = std::to_string(length);
+        PrintMeasurement(label + " bytes (wrong answer)", cells, [&](){
+            return LCH::levenshtein_distance(a8, b8);
+        });
+        PrintMeasurement(label + " utf8_levenshtein_distance", cells, [&](){
+            return LCH::utf8_levenshtein_distance(a8, b8);
+        });
+        PrintMeasurement(label + " std::u32string", cells, [&](){
+            return LCH::levenshtein_distance(a, b);
+        });
+    }
+}
+
+void BenchmarkIterators(std::size_t maxLength) {
+    for (const auto& model : costModels) {
+        const LCH::LevenshteinCosts& costs = model.second;
+        Bench::PrintTitle("ASCII through different iterators, " + model.first);
+        Bench::PrintRow("length", "time", "per cell", "rate");
+        std::mt19937 rng(4300);
+        for (std::size_t length : {16, 256, 4096}) {
+            if (length > maxLength) break;
+            auto a32 = EnglishLikeText(rng, length);
+            auto b32 = Mutated(rng, a32);
+            std::string a = ToUTF8(a32);
+            std::string b = ToUTF8(b32);
+            std::list<char> aList(a.begin(), a.end());
+            std::list<char> bList(b.begin(), b.end());
+            std::size_t cells = std::max<std::size_t>(1, a.size()*b.size());
+            std::string label = std::to_string(length);
+            PrintMeasurement(label + " const char*", cells, [&](){
+                return LCH::levenshtein_distance(a.c_str(), b.c_str(), costs);
+            });
+            PrintMeasurement(label + " std::string", cells, [&](){
+                return LCH::levenshtein_distance(a, b, costs);
+            });
+            PrintMeasurement(label + " std::list<char>", cells, [&](){
+                return LCH::levenshtein_distance(aList, bList, costs);
+            });
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::size_t maxLength = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                     : lengths.back();
+    BenchmarkAlphabet<std::string>("ASCII (English-like)", EnglishLikeText,
+                                   maxLength);
+    BenchmarkAlphabet<std::u32string>("Japanese (UTF-32)", JapaneseLikeText,
+                                      maxLength);
+    BenchmarkAlphabet<std::string>("DNA", DNAText, maxLength);
+    BenchmarkUTF8(maxLength);
+    BenchmarkIterators(maxLength);
+    return 0;
+}
@@ -7,15 +7,21 @@
 //    become useless.
 // 3. swap() is not allowed since there's no safe way to implement it.
 //
+// If you need any of these, or need several operations to happen atomically,
+// call locked() (or with_lock()) to get a view which holds the container's lock
+// for as long as it exists and provides the full interface of the underlying
+// standard container, references and all.
+//
 // Note: the "const"-ness of these containers refers to their contents, so the
 // mutexes are marked mutable.
 //
-// TODO: possibly allow the full range of operations in the following way:
-// - Add a member function which gives a unique_lock on the contained mutex
-// - Add the unsafe member functions (as well as the safe ones?) with an extra
-//   parameter for a reference to a unique_lock. If it contains the mutex for
-//   this container, then do the unsafe operation (or do the safe operation 
-//   without the container trying to acquire its own lock).
+// To wait on several AtomicQueues at once from a single thread, register them
+// with a Selector, which pops from whichever one has something available first.
+//
+// AtomicSnapshot is the exception to point 1 above: it's meant for values that
+// are read far more often than they're written, so instead of locking and
+// copying, readers get a snapshot which keeps the value alive while they use
+// it. See the comment on the class for details.
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -37,14 +43,64 @@
 #ifndef LCH_ATOMIC_CONTAINERS_HPP
 #define LCH_ATOMIC_CONTAINERS_HPP
 
+#include "hardware.hpp"
+#include "reclamation.hpp"
+
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
 #include <deque>
 #include <queue>
 #include <stdexcept>
+#include <algorithm>
 
 namespace LCH {
 
+class Selector;
+
+namespace Detail {
+
+// Shared by a Selector and the queues it watches: every push to one of those
+// queues bumps the count and wakes up the Selector if it's waiting.
+class SelectSignal {
+  public:
+    void Notify() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++count;
+        }
+        cv.notify_one();
+    }
+
+    std::uint64_t Count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    // Returns false if the deadline passed before anything was pushed.
+    bool WaitForChange(std::uint64_t seen, 
+                       std::chrono::steady_clock::time_point deadline) const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return cv.wait_until(lock, deadline, 
+                             [&](){ return count != seen; });
+    }
+    void WaitForChange(std::uint64_t seen) const {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&](){ return count != seen; });
+    }
+
+  private:
+    mutable std::mutex mutex;
+    mutable std::condition_variable cv;
+    std::uint64_t count = 0;
+};
+
+} // namespace Detail
+
 // Provides an atomic version of std::queue<T>, subject to the differences
 // described above; also, this container is bounds-checked and throws
 // std::out_of_range if the contents are accessed while it's empty.
@@ -66,6 +122,79 @@ class AtomicQueue {
     using ULock = std::unique_lock<std::mutex>;
 
   public:
+    using queue_type = std::queue<T, Container>;
+    using container_type = Container;
+    using value_type = typename queue_type::value_type;
+    using size_type = typename queue_type::size_type;
+    using reference = typename queue_type::reference;
+    using const_reference = typename queue_type::const_reference;
+
+    // A view of the queue which holds its lock until destroyed, providing the
+    // whole std::queue interface in the meantime. References into the queue
+    // obtained through a Locked are only valid while it exists. If anything is
+    // pushed through it, threads waiting on the queue are woken up once it's
+    // destroyed.
+    //
+    // Don't call the AtomicQueue's own member functions while you hold one of
+    // these, since they'll try to take the same lock and deadlock.
+    class Locked {
+      public:
+        Locked(const Locked&) = delete;
+        Locked& operator=(const Locked&) = delete;
+
+        ~Locked() {
+            if (pushed) queue.notify_selectors();
+            lock.unlock();
+            if (pushed) queue.data_cv.notify_all();
+        }
+
+        reference front() { return queue.data.front(); }
+        const_reference front() const { return queue.data.front(); }
+        reference back() { return queue.data.back(); }
+        const_reference back() const { return queue.data.back(); }
+
+        bool empty() const { return queue.data.empty(); }
+        size_type size() const { return queue.data.size(); }
+
+        void push(const value_type& value) {
+            queue.data.push(value);
+            pushed = true;
+        }
+        void push(value_type&& value) {
+            queue.data.push(std::move(value));
+            pushed = true;
+        }
+        template<class... Args>
+        decltype(auto) emplace(Args&&... args) {
+            pushed = true;
+            return queue.data.emplace(std::forward<Args>(args)...);
+        }
+        void pop() { queue.data.pop(); }
+
+        void swap(queue_type& other) {
+            queue.data.swap(other);
+            pushed = true;
+        }
+
+      private:
+        friend class AtomicQueue;
+        explicit Locked(AtomicQueue& queue): queue(queue), 
+                                             lock(queue.data_mutex) {}
+
+        AtomicQueue& queue;
+        ULock lock;
+        bool pushed = false;
+    };
+
+    Locked locked() { return Locked(*this); }
+
+    // Calls function(Locked&) while holding the lock and returns its result.
+    template<class Function>
+    decltype(auto) with_lock(Function&& function) {
+        Locked view(*this);
+        return std::forward<Function>(function)(view);
+    }
+
     T front() const { 
         ULock lock(data_mutex); 
         if (data.empty()) {
@@ -91,6 +220,7 @@ class AtomicQueue {
         {
             Lock lock(data_mutex); 
             data.push(value); 
+            notify_selectors();
         }
         data_cv.notify_one();
     }
@@ -98,6 +228,7 @@ class AtomicQueue {
         {
             Lock lock(data_mutex); 
             data.push(std::move(value)); 
+            notify_selectors();
         }
         data_cv.notify_one();
     }
@@ -107,6 +238,7 @@ class AtomicQueue {
         {
             Lock lock(data_mutex); 
             data.emplace(std::forward<Args>(args)...); 
+            notify_selectors();
         }
         data_cv.notify_one();
     }
@@ -123,6 +255,12 @@ class AtomicQueue {
         return output;
     }
 
+    // non-blocking pop: if the queue has anything in it, moves the front entry
+    // into output, removes it, and returns true; otherwise returns false
+    bool try_pop(T& output) {
+        return pop_if_any([&output](T&& value){ output = std::move(value); });
+    }
+
     void clear() {
         Lock lock(data_mutex);
         data = {};
@@ -166,9 +304,265 @@ class AtomicQueue {
     }
 
   private:
-    std::queue<T, Container> data;
-    mutable std::mutex data_mutex;
-    mutable std::condition_variable data_cv;
+    friend class Selector;
+
+    // Producers and consumers both touch the queue and its mutex together, so
+    // they share a cache line; the condition variable is notified outside the
+    // lock, so it gets a line of its own. Aligning the first member also keeps
+    // neighbouring objects (e.g. other queues in an array) off these lines.
+    alignas(cacheLineSize) mutable std::mutex data_mutex;
+    queue_type data;
+    std::vector<Detail::SelectSignal*> selectors;
+    alignas(cacheLineSize) mutable std::condition_variable data_cv;
+
+    // must be called with data_mutex held
+    void notify_selectors() {
+        for (Detail::SelectSignal* selector : selectors) selector->Notify();
+    }
+
+    void add_selector(Detail::SelectSignal* selector) {
+        Lock lock(data_mutex);
+        selectors.push_back(selector);
+    }
+    void remove_selector(Detail::SelectSignal* selector) {
+        Lock lock(data_mutex);
+        selectors.erase(std::remove(selectors.begin(), selectors.end(), 
+                                    selector), selectors.end());
+    }
+
+    // If the queue isn't empty, pops the front entry and passes it to handler
+    // (after releasing the lock, so handler can use the queue) and returns
+    // true; otherwise returns false. This is how we get a T out without
+    // default constructing one first.
+    template<class Handler>
+    bool pop_if_any(Handler&& handler) {
+        ULock lock(data_mutex);
+        if (data.empty()) return false;
+        T output = std::move(data.front());
+        data.pop();
+        lock.unlock();
+        std::forward<Handler>(handler)(std::move(output));
+        return true;
+    }
+};
+
+// Waits on any number of AtomicQueues at once, like Go's select statement.
+// Each queue is added along with a handler; wait() blocks until at least one of
+// the queues has something in it, then pops one entry from it and passes it to
+// that queue's handler. The queues don't have to hold the same type.
+//
+// LCH::Selector selector;
+// selector.add(requests, [](Request r){ Handle(std::move(r)); });
+// selector.add(shutdown, [&running](bool){ running = false; });
+// while (running) selector.wait();
+//
+// Every push to a watched queue wakes up the Selector, so one thread can
+// replace a whole set of threads which would each be blocked on one queue.
+// Ready queues are handled in round-robin order so that a busy queue can't
+// starve the others. Other threads may still pop from the queues as normal.
+//
+// A Selector is meant to be used by one thread at a time, and it must be
+// destroyed before any of the queues it's watching.
+class Selector {
+  public:
+    // returned by try_wait and wait_for when nothing was ready
+    static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+    Selector() = default;
+    Selector(const Selector&) = delete;
+    Selector& operator=(const Selector&) = delete;
+
+    ~Selector() {
+        for (auto& entry : cases) entry->unregister(&signal);
+    }
+
+    // Start watching queue; handler will be called with each T popped from it.
+    // Returns the index which wait() will return when this queue is handled.
+    template<class T, class Container, class Handler>
+    std::size_t add(AtomicQueue<T, Container>& queue, Handler handler) {
+        cases.push_back(std::make_unique<Case<T, Container, Handler>>(
+                    queue, std::move(handler)));
+        queue.add_selector(&signal);
+        return cases.size() - 1;
+    }
+
+    // Handles one entry from a queue which has one available, if any, and
+    // returns that queue's index; otherwise returns none without blocking.
+    std::size_t try_wait() {
+        for (std::size_t i = 0; i < cases.size(); ++i) {
+            std::size_t index = (next + i) % cases.size();
+            if (cases[index]->try_handle()) {
+                next = index + 1;
+                return index;
+            }
+        }
+        return none;
+    }
+
+    // Blocks until an entry from one of the queues has been handled, and
+    // returns the index of the queue it came from.
+    std::size_t wait() {
+        while (true) {
+            std::uint64_t seen = signal.Count();
+            std::size_t index = try_wait();
+            if (index != none) return index;
+            signal.WaitForChange(seen);
+        }
+    }
+
+    // As wait(), but gives up and returns none after timeout.
+    template<class Rep, class Period>
+    std::size_t wait_for(const std::chrono::duration<Rep, Period>& timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            std::uint64_t seen = signal.Count();
+            std::size_t index = try_wait();
+            if (index != none) return index;
+            if (!signal.WaitForChange(seen, deadline)) return try_wait();
+        }
+    }
+
+  private:
+    class AbstractCase {
+      public:
+        virtual ~AbstractCase() = default;
+        virtual bool try_handle() = 0;
+        virtual void unregister(Detail::SelectSignal* signal) = 0;
+    };
+
+    template<class T, class Container, class Handler>
+    class Case : public AbstractCase {
+      public:
+        Case(AtomicQueue<T, Container>& queue, Handler&& handler):
+                queue(queue), handler(std::move(handler)) {}
+
+        bool try_handle() override { return queue.pop_if_any(handler); }
+        void unregister(Detail::SelectSignal* signal) override {
+            queue.remove_selector(signal);
+        }
+
+      private:
+        AtomicQueue<T, Container>& queue;
+        Handler handler;
+    };
+
+    Detail::SelectSignal signal;
+    std::vector<std::unique_ptr<AbstractCase>> cases;
+    std::size_t next = 0;
+};
+
+// Provides read-copy-update access to a value which is read often and replaced
+// rarely, like a configuration loaded into LCH::Options. Readers never block:
+// load() pins an EpochDomain and returns a Snapshot of whatever value was
+// current at that moment. Writers build a complete new value and publish it
+// with store() or update(); readers see either the old value or the new one,
+// never a mix. Each store() or update() frees the values it replaced which no
+// Snapshot refers to any more; one that was still being read when it was
+// replaced is freed by the next write (or by collecting the domain) after the
+// last Snapshot of it has gone away.
+//
+// LCH::AtomicSnapshot<LCH::Options> config(ReadConfig());
+// auto current = config.load();
+// const std::string& level = current->Value("log_level");
+// ...
+// config.store(ReadConfig()); // e.g. on SIGHUP
+//
+// A Snapshot keeps the calling thread pinned to the domain until it's
+// destroyed, which holds up the freeing of everything retired to that domain
+// in the meantime, so don't hold on to one for longer than you need it. Like
+// EpochDomain::Guard, a Snapshot must stay on the thread which created it.
+template<class T>
+class AtomicSnapshot {
+  public:
+    class Snapshot {
+      public:
+        const T& operator*() const noexcept { return *value; }
+        const T* operator->() const noexcept { return value; }
+        const T* get() const noexcept { return value; }
+
+      private:
+        friend class AtomicSnapshot;
+        Snapshot(EpochDomain::Guard&& guard, const T* value) noexcept:
+                guard(std::move(guard)), value(value) {}
+
+        EpochDomain::Guard guard;
+        const T* value;
+    };
+
+    explicit AtomicSnapshot(T initial,
+                            EpochDomain& domain = EpochDomain::Default()):
+            AtomicSnapshot(std::make_unique<T>(std::move(initial)), domain) {}
+    explicit AtomicSnapshot(std::unique_ptr<T> initial,
+                            EpochDomain& domain = EpochDomain::Default()):
+            domain(domain), current(NotNull(std::move(initial)).release()) {}
+
+    AtomicSnapshot(const AtomicSnapshot&) = delete;
+    AtomicSnapshot& operator=(const AtomicSnapshot&) = delete;
+
+    ~AtomicSnapshot() {
+        domain.Retire(current.load(std::memory_order_relaxed));
+    }
+
+    Snapshot load() const {
+        auto guard = domain.Pin();
+        const T* value = current.load(std::memory_order_acquire);
+        return Snapshot(std::move(guard), value);
+    }
+
+    void store(T value) {
+        store(std::make_unique<T>(std::move(value)));
+    }
+    void store(std::unique_ptr<T> value) {
+        T* newValue = NotNull(std::move(value)).release();
+        T* oldValue;
+        {
+            Lock lock(write_mutex);
+            oldValue = current.exchange(newValue, std::memory_order_acq_rel);
+        }
+        domain.Retire(oldValue);
+        Reclaim();
+    }
+
+    // Copies the current value, applies modify(T&) to the copy, and publishes
+    // the result. Writers are serialized, so no concurrent store() or update()
+    // can be lost, but this does not block readers.
+    template<class Function>
+    void update(Function&& modify) {
+        T* oldValue;
+        {
+            Lock lock(write_mutex);
+            auto newValue = std::make_unique<T>(
+                    *current.load(std::memory_order_acquire));
+            std::forward<Function>(modify)(*newValue);
+            oldValue = current.exchange(newValue.release(),
+                                        std::memory_order_acq_rel);
+        }
+        domain.Retire(oldValue);
+        Reclaim();
+    }
+
+  private:
+    using Lock = std::lock_guard<std::mutex>;
+
+    EpochDomain& domain;
+    std::atomic<T*> current;
+    std::mutex write_mutex;
+
+    // Writes are rare, so rather than waiting for a whole batch of them, free
+    // old values straight away: something retired in one epoch can be freed
+    // two epochs later, if no one is still reading it.
+    void Reclaim() {
+        domain.Collect();
+        domain.Collect();
+    }
+
+    static std::unique_ptr<T> NotNull(std::unique_ptr<T> value) {
+        if (value == nullptr) {
+            throw std::invalid_argument("LCH::AtomicSnapshot: a null value "
+                                        "can not be published");
+        }
+        return value;
+    }
 };
 
 } // namespace LCH
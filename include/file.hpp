@@ -1,6 +1,10 @@
 ///////////////////////////////////////////////////////////////////////////////
 // file.hpp: a smart interchange between std::filesystem and boost::filesystem
-// depending on the compiler's support for C++17.
+// depending on the compiler's support for C++17, plus a few file utilities.
+//
+// MappedFile gives read-only access to the bytes of a whole file, through mmap
+// on POSIX systems (so pages are only read from disk when they're touched)
+// and by reading it into memory elsewhere.
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -42,6 +46,18 @@ inline std::ostream& operator<<(std::ostream& os, const LCH::File::path& path) {
 
 #include <fstream>
 #include <iterator>
+#include <vector>
+#include <utility> // swap
+#include <cstddef>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LCH_HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace LCH {
 
@@ -72,6 +88,98 @@ inline bool BytesAreIdentical(const LCH::File::path& pathA,
                       std::istreambuf_iterator<char>(fileB.rdbuf()));
 }
 
+class MappedFile {
+  public:
+    explicit MappedFile(const LCH::File::path& path) {
+#ifdef LCH_HAS_MMAP
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error(__FILE__ ": could not open file at "
+                                     "provided path " + path.string());
+        }
+        struct stat info;
+        if (fstat(fd, &info) == -1) {
+            close(fd);
+            throw std::runtime_error(__FILE__ ": could not get the size of "
+                                     + path.string());
+        }
+        size = static_cast<std::size_t>(info.st_size);
+        // mmap refuses empty mappings, and an empty file doesn't need one
+        if (size > 0) {
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error(__FILE__ ": could not map "
+                                         + path.string());
+            }
+            data = static_cast<const char*>(mapped);
+        }
+        close(fd);
+#else
+        std::ifstream inStream(path.native(), std::ifstream::binary);
+        if (inStream.fail()) {
+            throw std::runtime_error(__FILE__ ": could not open file at "
+                                     "provided path " + path.string());
+        }
+        buffer.assign(std::istreambuf_iterator<char>(inStream),
+                      std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+#endif
+    }
+
+    // can move a MappedFile but not copy it
+    MappedFile(const MappedFile& toCopy) = delete;
+    MappedFile& operator=(const MappedFile& toCopy) = delete;
+    MappedFile(MappedFile&& toMove) noexcept { Swap(toMove); }
+    MappedFile& operator=(MappedFile&& toMove) noexcept {
+        Swap(toMove);
+        return *this;
+    }
+
+    ~MappedFile() {
+#ifdef LCH_HAS_MMAP
+        if (data != nullptr) munmap(const_cast<char*>(data), size);
+#endif
+    }
+
+    // Tells the OS how the bytes will be read, where that makes a difference.
+    void AdviseSequential() const noexcept {
+#ifdef LCH_HAS_MMAP
+        if (data != nullptr) {
+            madvise(const_cast<char*>(data), size, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+    void AdviseRandom() const noexcept {
+#ifdef LCH_HAS_MMAP
+        if (data != nullptr) {
+            madvise(const_cast<char*>(data), size, MADV_RANDOM);
+        }
+#endif
+    }
+
+    const char* Data() const noexcept { return data; }
+    std::size_t Size() const noexcept { return size; }
+    const char* begin() const noexcept { return data; }
+    const char* end() const noexcept { return data + size; }
+
+  private:
+    void Swap(MappedFile& other) noexcept {
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+#ifndef LCH_HAS_MMAP
+        buffer.swap(other.buffer);
+#endif
+    }
+
+    const char* data = nullptr;
+    std::size_t size = 0;
+#ifndef LCH_HAS_MMAP
+    std::vector<char> buffer;
+#endif
+};
+
 } // namespace LCH
 
 #endif // LCH_FILE_HPP
@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// hardware.hpp: information about the machine that other LCH headers use to
+// lay out their data and choose between implementations.
+//
+// cacheLineSize is the distance objects written by different threads should be
+// kept apart to avoid false sharing, i.e. two cores fighting over a cache line
+// which contains unrelated data each of them is writing. It's taken from
+// std::hardware_destructive_interference_size where that's available, except
+// on GCC, which warns that its value changes with -mtune and so can make
+// different translation units disagree about the layout of a class; there, and
+// wherever else the standard value is missing, it falls back to 64 bytes. You
+// can override it by defining LCH_CACHE_LINE_SIZE before including any LCH
+// headers (do this consistently across your whole program!).
+//
+// Cpu() reports which SIMD instruction sets the machine we're running on
+// supports. Headers with SIMD code compile it for each instruction set using
+// function target attributes and use Cpu() to pick the best version at
+// runtime, so you don't need to build with -mavx2 etc. to benefit from them,
+// and the same binary still works on older machines. This is only supported
+// for x86 with GCC or clang (where LCH_X86_SIMD is defined); everywhere else,
+// every feature is reported as missing and the portable code is used.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2018-2019 by Joyz Inc of Tokyo, Japan (author: Charles Hussong) //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_HARDWARE_HPP
+#define LCH_HARDWARE_HPP
+
+#include <cstddef>
+#include <new>
+
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__GNUC__) || defined(__clang__))
+#define LCH_X86_SIMD 1
+#endif
+
+namespace LCH {
+
+#if defined(LCH_CACHE_LINE_SIZE)
+constexpr std::size_t cacheLineSize = LCH_CACHE_LINE_SIZE;
+#elif defined(__cpp_lib_hardware_interference_size) \
+    && (defined(__clang__) || !defined(__GNUC__))
+constexpr std::size_t cacheLineSize = std::hardware_destructive_interference_size;
+#else
+constexpr std::size_t cacheLineSize = 64;
+#endif
+
+struct CpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;
+    bool fma = false;
+};
+
+inline const CpuFeatures& Cpu() noexcept {
+    static const CpuFeatures features = [](){
+        CpuFeatures detected;
+#ifdef LCH_X86_SIMD
+        __builtin_cpu_init();
+        detected.sse41 = __builtin_cpu_supports("sse4.1");
+        detected.avx2 = __builtin_cpu_supports("avx2");
+        detected.fma = __builtin_cpu_supports("fma");
+#endif
+        return detected;
+    }();
+    return features;
+}
+
+} // namespace LCH
+
+#endif // LCH_HARDWARE_HPP
@@ -17,6 +17,36 @@
 // The left argument ("a" above) is taken to be the "base", so if b is longer
 // there will be insertions and if b is shorter there will be deletions.
 //
+// Any prefix and suffix the two sides have in common are skipped before doing
+// anything else (the suffix only if both iterators are bidirectional), since
+// they don't affect the distance; in particular, identical sides are found to
+// be at distance 0 in a single pass.
+//
+// If you only need to know whether the distance is at most some maxDist, use
+// levenshtein_distance_bounded instead, which takes the same arguments with
+// maxDist before the costs and returns maxDist + 1 for anything further apart.
+// It only looks at the part of the DP matrix that paths costing at most
+// maxDist can pass through, and gives up as soon as none of them can finish.
+//
+// osa_distance and damerau_levenshtein_distance take the same arguments, and
+// also allow two adjacent symbols to be swapped, at a cost of costs.trans
+// (which levenshtein_distance ignores). The optimal string alignment version
+// doesn't allow swapped symbols to be edited again; the full Damerau version
+// does, at the price of keeping the whole DP matrix in memory. There's also an
+// osa_distance_bounded, which works like levenshtein_distance_bounded. These
+// aren't noexcept, since their working memory (the Damerau matrix in
+// particular) may be too big to allocate, which throws std::bad_alloc.
+//
+// When all three costs are equal and both sides hold the same integral type
+// (e.g. two strings of the same character type), the distance is computed with
+// Myers' bit-parallel algorithm (in the form given by Hyyro), which handles 64
+// characters of the shorter side per word operation instead of one. If the
+// costs differ, inputs of at least a few dozen symbols are instead processed
+// one anti-diagonal at a time, since all the cells on an anti-diagonal can be
+// computed independently, using AVX2 or SSE4.1 if the CPU supports them (see
+// hardware.hpp). All of this happens automatically; other inputs use the
+// one-row method.
+//
 // WARNING: const char* and char arrays are assumed to represent C-style
 // strings, so their final character (assumed to be '\0') is not considered.
 // This is so that they can be compared with std::string and std::string_view;
@@ -39,8 +69,20 @@
 // limitations under the License.                                            //
 ///////////////////////////////////////////////////////////////////////////////
 
+#ifndef LCH_LEVENSHTEIN_HPP
+#define LCH_LEVENSHTEIN_HPP
+
+#include "hardware.hpp"
+
+#ifdef LCH_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #include <vector>
+#include <array>
 #include <tuple>
+#include <limits>
+#include <cstdint>
 #include <algorithm> // min
 #include <iterator> // distance
 #include <type_traits> // enable_if and other template magic
@@ -51,6 +93,7 @@ struct LevenshteinCosts {
     std::size_t sub = 1;
     std::size_t ins = 1;
     std::size_t del = 1;
+    std::size_t trans = 1; // only used by osa_ and damerau_ functions
 };
 
 
@@ -74,10 +117,10 @@ namespace Detail {
     template<typename T>
     std::is_same<T, const char*> is_iterable_impl(...);
 
-    const char* begin(const char* str) noexcept {
+    inline const char* begin(const char* str) noexcept {
         return str;
     }
-    const char* end(const char* str) noexcept {
+    inline const char* end(const char* str) noexcept {
         if (str == nullptr) return str;
 
         while (*str != '\0') ++str;
@@ -89,34 +132,1103 @@ template<typename T>
 using is_iterable = decltype(Detail::is_iterable_impl<T>(0));
 
 
+namespace Detail {
+    template<class InputIt>
+    using symbol_t = std::remove_cv_t<
+        typename std::iterator_traits<InputIt>::value_type>;
+
+    // The bit-parallel and SIMD kernels map the symbols of both sides to
+    // integers (table rows or lane values), so they need both sides to have the
+    // same type, and that type's == to mean "same value" exactly.
+    template<class InputItA, class InputItB>
+    constexpr bool integral_symbols = 
+        std::is_integral<symbol_t<InputItA>>::value &&
+        !std::is_same<symbol_t<InputItA>, bool>::value &&
+        std::is_same<symbol_t<InputItA>, symbol_t<InputItB>>::value;
+
+    // Drops the common prefix of [aBegin, aEnd) and [bBegin, bEnd), and if
+    // both iterators are bidirectional, their common suffix, adjusting the
+    // sizes to match. This never changes the distance (for any costs): an
+    // alignment which doesn't match two equal end symbols with each other can
+    // be changed into one that does without costing more.
+    template<class InputItA, class InputItB>
+    void TrimCommonEnds(InputItA& aBegin, InputItA& aEnd, std::size_t& sizeA,
+                        InputItB& bBegin, InputItB& bEnd, std::size_t& sizeB) {
+        while (sizeA > 0 && sizeB > 0 && *aBegin == *bBegin) {
+            ++aBegin;
+            ++bBegin;
+            --sizeA;
+            --sizeB;
+        }
+
+        using TagA = 
+            typename std::iterator_traits<InputItA>::iterator_category;
+        using TagB = 
+            typename std::iterator_traits<InputItB>::iterator_category;
+        using Bidirectional = std::bidirectional_iterator_tag;
+        if constexpr (std::is_base_of<Bidirectional, TagA>::value 
+                      && std::is_base_of<Bidirectional, TagB>::value) {
+            while (sizeA > 0 && sizeB > 0) {
+                InputItA aLast = std::prev(aEnd);
+                InputItB bLast = std::prev(bEnd);
+                if (!(*aLast == *bLast)) break;
+                aEnd = aLast;
+                bEnd = bLast;
+                --sizeA;
+                --sizeB;
+            }
+        }
+    }
+
+    // Memory kept by each thread between calls, so that computing many small
+    // distances doesn't mean as many allocations. There are a few separate
+    // buffers for functions which need more than one at once; the contents
+    // are garbage until written.
+    enum class ScratchSlot { row, a, b, diagonals, decodedA, decodedB,
+                             patternKeys, patternRows, patternMasks, symbols,
+                             count };
+
+    template<class T>
+    T* Scratch(ScratchSlot slot, std::size_t count) {
+        thread_local std::array<std::vector<unsigned char>, 
+                                static_cast<std::size_t>(ScratchSlot::count)> 
+            buffers;
+        auto& buffer = buffers[static_cast<std::size_t>(slot)];
+        if (buffer.size() < count*sizeof(T)) buffer.resize(count*sizeof(T));
+        return reinterpret_cast<T*>(buffer.data());
+    }
+
+    // Calls f with a zero of the narrowest unsigned type which can hold max,
+    // so that DP rows can use the smallest cells that will do.
+    template<class Function>
+    decltype(auto) WithCellsFor(std::size_t max, Function&& f) {
+        if (max <= std::numeric_limits<std::uint8_t>::max()) {
+            return f(std::uint8_t(0));
+        } else if (max <= std::numeric_limits<std::uint16_t>::max()) {
+            return f(std::uint16_t(0));
+        } else if (max <= std::numeric_limits<std::uint32_t>::max()) {
+            return f(std::uint32_t(0));
+        } else {
+            return f(std::size_t(0));
+        }
+    }
+
+    // The most any cell of the DP matrix (plus one more cost, for the sums
+    // that get compared) can be, or SIZE_MAX if that would overflow.
+    inline std::size_t CellBound(std::size_t sizeA, std::size_t sizeB,
+                                 const LevenshteinCosts& costs) noexcept {
+        constexpr std::size_t max = std::numeric_limits<std::size_t>::max();
+        std::size_t maxCost = std::max({costs.sub, costs.ins, costs.del});
+        if ((costs.del > 0 && sizeA > max/3/costs.del)
+            || (costs.ins > 0 && sizeB > max/3/costs.ins) 
+            || maxCost > max/3) {
+            return max;
+        }
+        return sizeA*costs.del + sizeB*costs.ins + maxCost;
+    }
+
+    // Where a PatternMasks keeps its tables: in this thread's scratch memory,
+    // for one that's built for a single call and dropped before any other is
+    // built on the same thread (so repeated calls don't allocate), or in
+    // memory of its own, for one that's kept (and maybe shared with other
+    // threads).
+    enum class PatternStorage { scratch, owned };
+
+    // Bit masks recording where each symbol occurs in a pattern: bit i of
+    // Mask(Row(c), k) is set if pattern[64*k + i] == c. Patterns longer than
+    // 64 are split into Blocks() words.
+    //
+    // Single-byte symbols index a 256-row table directly (stored inline when
+    // the pattern fits in one word); wider symbols are looked up in a small
+    // hash table which assigns a row to each distinct symbol in the pattern,
+    // with one extra row of zeros for symbols which don't appear in it. The
+    // tables are found through pointers, so these can't be copied or moved.
+    template<class Symbol, bool byte = (sizeof(Symbol) == 1)>
+    class PatternMasks {
+      public:
+        template<class ForwardIt>
+        PatternMasks(ForwardIt begin, ForwardIt end,
+                     PatternStorage storage = PatternStorage::scratch):
+                size(std::distance(begin, end)), blocks((size + 63)/64) {
+            capacity = 8;
+            while (capacity < 2*size) capacity *= 2;
+            // at most one row per symbol, and the row of zeros
+            std::size_t maxMasks = (size + 1)*blocks;
+            if (storage == PatternStorage::scratch) {
+                keys = Scratch<Symbol>(ScratchSlot::patternKeys, capacity);
+                rows = Scratch<std::uint32_t>(ScratchSlot::patternRows,
+                                              capacity);
+                table = Scratch<std::uint64_t>(ScratchSlot::patternMasks,
+                                               maxMasks);
+            } else {
+                ownedKeys.resize(capacity);
+                ownedRows.resize(capacity);
+                ownedTable.resize(maxMasks);
+                keys = ownedKeys.data();
+                rows = ownedRows.data();
+                table = ownedTable.data();
+            }
+            std::fill(rows, rows + capacity, empty);
+            std::uint32_t nextRow = 0;
+            for (ForwardIt it = begin; it != end; ++it) {
+                std::size_t slot = Slot(*it);
+                if (rows[slot] == empty) {
+                    keys[slot] = *it;
+                    rows[slot] = nextRow++;
+                }
+            }
+            missing = nextRow;
+            std::fill(table, table + (missing + 1)*blocks, 0);
+            std::size_t i = 0;
+            for (ForwardIt it = begin; it != end; ++it, ++i) {
+                table[Row(*it)*blocks + i/64] |= std::uint64_t(1) << (i % 64);
+            }
+        }
+
+        PatternMasks(const PatternMasks&) = delete;
+        PatternMasks& operator=(const PatternMasks&) = delete;
+
+        std::size_t Size() const noexcept { return size; }
+        std::size_t Blocks() const noexcept { return blocks; }
+
+        std::size_t Row(Symbol c) const noexcept {
+            std::size_t slot = Slot(c);
+            return rows[slot] == empty ? missing : rows[slot];
+        }
+        std::uint64_t Mask(std::size_t row, std::size_t block) const noexcept {
+            return table[row*blocks + block];
+        }
+
+      private:
+        static constexpr std::uint32_t empty = static_cast<std::uint32_t>(-1);
+
+        std::size_t size;
+        std::size_t blocks;
+        std::size_t capacity;
+        Symbol* keys;
+        std::uint32_t* rows;
+        std::uint32_t missing;
+        std::uint64_t* table;
+        std::vector<Symbol> ownedKeys;
+        std::vector<std::uint32_t> ownedRows;
+        std::vector<std::uint64_t> ownedTable;
+
+        // the slot holding c, or the empty slot where it would go
+        std::size_t Slot(Symbol c) const noexcept {
+            std::size_t mask = capacity - 1;
+            std::size_t slot = (static_cast<std::uint64_t>(c) 
+                                * 0x9E3779B97F4A7C15ull) >> 32 & mask;
+            while (rows[slot] != empty && keys[slot] != c) {
+                slot = (slot + 1) & mask;
+            }
+            return slot;
+        }
+    };
+
+    template<class Symbol>
+    class PatternMasks<Symbol, true> {
+      public:
+        template<class ForwardIt>
+        PatternMasks(ForwardIt begin, ForwardIt end,
+                     PatternStorage storage = PatternStorage::scratch):
+                size(std::distance(begin, end)), blocks((size + 63)/64) {
+            if (blocks == 1) {
+                table = inlineTable.data();
+            } else if (storage == PatternStorage::scratch) {
+                table = Scratch<std::uint64_t>(ScratchSlot::patternMasks,
+                                               256*blocks);
+                std::fill(table, table + 256*blocks, 0);
+            } else {
+                ownedTable.assign(256*blocks, 0);
+                table = ownedTable.data();
+            }
+            std::size_t i = 0;
+            for (ForwardIt it = begin; it != end; ++it, ++i) {
+                table[Row(*it)*blocks + i/64] |= std::uint64_t(1) << (i % 64);
+            }
+        }
+
+        PatternMasks(const PatternMasks&) = delete;
+        PatternMasks& operator=(const PatternMasks&) = delete;
+
+        std::size_t Size() const noexcept { return size; }
+        std::size_t Blocks() const noexcept { return blocks; }
+
+        std::size_t Row(Symbol c) const noexcept {
+            return static_cast<unsigned char>(c);
+        }
+        std::uint64_t Mask(std::size_t row, std::size_t block) const noexcept {
+            return table[row*blocks + block];
+        }
+
+      private:
+        std::size_t size;
+        std::size_t blocks;
+        std::array<std::uint64_t, 256> inlineTable{};
+        std::uint64_t* table;
+        std::vector<std::uint64_t> ownedTable;
+    };
+
+    // One step of Hyyro's block-based version of Myers' algorithm: advances a
+    // 64-row block of the DP column by one text symbol, given the symbol's
+    // match mask for the block and the horizontal difference (-1, 0, or +1)
+    // entering the block from above. Pv and Mv hold the positive and negative
+    // vertical differences down the column. Returns the horizontal difference
+    // leaving the bottom of the block, at the bit given by highBit.
+    inline int AdvanceBlock(std::uint64_t& Pv, std::uint64_t& Mv, 
+                            std::uint64_t Eq, int hin, 
+                            std::uint64_t highBit) noexcept {
+        std::uint64_t hinIsNeg = static_cast<std::uint64_t>(hin < 0);
+        std::uint64_t Xv = Eq | Mv;
+        Eq |= hinIsNeg;
+        std::uint64_t Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+        std::uint64_t Ph = Mv | ~(Xh | Pv);
+        std::uint64_t Mh = Pv & Xh;
+        int hout = static_cast<int>((Ph & highBit) != 0) 
+                 - static_cast<int>((Mh & highBit) != 0);
+        Ph = (Ph << 1) | static_cast<std::uint64_t>(hin > 0);
+        Mh = (Mh << 1) | hinIsNeg;
+        Pv = Mh | ~(Xv | Ph);
+        Mv = Ph & Xv;
+        return hout;
+    }
+
+    // Unit-cost Levenshtein distance between the pattern and [textBegin,
+    // textEnd) in O(Blocks()*textLength) word operations. The score can only
+    // fall by one per remaining text symbol, so once it's too high to get back
+    // down to maxDist, this gives up and returns maxDist + 1.
+    template<class Masks, class InputIt>
+    std::size_t MyersDistance(
+            const Masks& pattern, InputIt textBegin, InputIt textEnd,
+            std::size_t maxDist = std::numeric_limits<std::size_t>::max()) {
+        std::size_t size = pattern.Size();
+        std::size_t remaining = std::distance(textBegin, textEnd);
+        if (size == 0) return std::min(remaining, maxDist + 1);
+
+        std::size_t blocks = pattern.Blocks();
+        std::uint64_t lastBit = std::uint64_t(1) << ((size - 1) % 64);
+        std::size_t score = size;
+        auto hopeless = [&](){ 
+            return score > maxDist && score - maxDist > remaining; 
+        };
+
+        if (blocks == 1) {
+            std::uint64_t Pv = ~std::uint64_t(0);
+            std::uint64_t Mv = 0;
+            for (InputIt it = textBegin; it != textEnd; ++it) {
+                std::uint64_t Eq = pattern.Mask(pattern.Row(*it), 0);
+                score += AdvanceBlock(Pv, Mv, Eq, 1, lastBit);
+                remaining -= 1;
+                if (hopeless()) return maxDist + 1;
+            }
+            return score > maxDist ? maxDist + 1 : score;
+        }
+
+        constexpr std::uint64_t highBit = std::uint64_t(1) << 63;
+        std::uint64_t* Pv = Scratch<std::uint64_t>(ScratchSlot::a, blocks);
+        std::uint64_t* Mv = Scratch<std::uint64_t>(ScratchSlot::b, blocks);
+        std::fill(Pv, Pv + blocks, ~std::uint64_t(0));
+        std::fill(Mv, Mv + blocks, 0);
+        for (InputIt it = textBegin; it != textEnd; ++it) {
+            std::size_t row = pattern.Row(*it);
+            int carry = 1; // the top row of the DP matrix increases by 1
+            for (std::size_t k = 0; k + 1 < blocks; ++k) {
+                carry = AdvanceBlock(Pv[k], Mv[k], pattern.Mask(row, k), 
+                                     carry, highBit);
+            }
+            score += AdvanceBlock(Pv[blocks-1], Mv[blocks-1], 
+                                  pattern.Mask(row, blocks-1), carry, lastBit);
+            remaining -= 1;
+            if (hopeless()) return maxDist + 1;
+        }
+        return score > maxDist ? maxDist + 1 : score;
+    }
+
+    // Unit-cost distance between two sequences of the same integral type,
+    // using the shorter one as the pattern.
+    template<class InputItA, class InputItB>
+    std::size_t BitParallelDistance(
+            InputItA aBegin, InputItA aEnd, std::size_t sizeA,
+            InputItB bBegin, InputItB bEnd, std::size_t sizeB,
+            std::size_t maxDist = std::numeric_limits<std::size_t>::max()) {
+        using Symbol = symbol_t<InputItA>;
+        if (sizeA <= sizeB) {
+            return MyersDistance(PatternMasks<Symbol>(aBegin, aEnd), 
+                                 bBegin, bEnd, maxDist);
+        } else {
+            return MyersDistance(PatternMasks<Symbol>(bBegin, bEnd), 
+                                 aBegin, aEnd, maxDist);
+        }
+    }
+
+    // Computes one anti-diagonal of the DP matrix (or part of it) given the
+    // two before it: out[k] is the least of diag[k] + (a[k] == b[k] ? 0 : sub),
+    // left[k] + ins, and up[k] + del. Each cell depends only on the previous
+    // diagonals, so this vectorizes, unlike a row. The SIMD versions finish
+    // with the scalar one.
+    template<class Cell>
+    void DiagonalStep(Cell* out, const Cell* diag, const Cell* left, 
+                      const Cell* up, const Cell* a, const Cell* b, 
+                      std::size_t count, Cell sub, Cell ins, 
+                      Cell del) noexcept {
+        for (std::size_t k = 0; k < count; ++k) {
+            Cell subCost = diag[k] + (a[k] == b[k] ? 0 : sub);
+            Cell insCost = left[k] + ins;
+            Cell delCost = up[k] + del;
+            out[k] = std::min(subCost, std::min(insCost, delCost));
+        }
+    }
+
+#ifdef LCH_X86_SIMD
+    __attribute__((target("avx2")))
+    inline __m256i LoadAVX2(const void* p) noexcept {
+        return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+    }
+
+    __attribute__((target("sse4.1")))
+    inline __m128i LoadSSE41(const void* p) noexcept {
+        return _mm_loadu_si128(static_cast<const __m128i*>(p));
+    }
+
+    __attribute__((target("avx2")))
+    inline void DiagonalStepAVX2(
+            std::uint16_t* out, const std::uint16_t* diag, 
+            const std::uint16_t* left, const std::uint16_t* up, 
+            const std::uint16_t* a, const std::uint16_t* b, std::size_t count,
+            std::uint16_t sub, std::uint16_t ins, std::uint16_t del) noexcept {
+        const __m256i vsub = _mm256_set1_epi16(static_cast<short>(sub));
+        const __m256i vins = _mm256_set1_epi16(static_cast<short>(ins));
+        const __m256i vdel = _mm256_set1_epi16(static_cast<short>(del));
+        std::size_t k = 0;
+        for (; k + 16 <= count; k += 16) {
+            __m256i same = _mm256_cmpeq_epi16(LoadAVX2(a + k), LoadAVX2(b + k));
+            __m256i subCost = _mm256_add_epi16(LoadAVX2(diag + k), 
+                                               _mm256_andnot_si256(same, vsub));
+            __m256i insCost = _mm256_add_epi16(LoadAVX2(left + k), vins);
+            __m256i delCost = _mm256_add_epi16(LoadAVX2(up + k), vdel);
+            __m256i best = _mm256_min_epu16(subCost, 
+                                            _mm256_min_epu16(insCost, delCost));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), best);
+        }
+        DiagonalStep(out + k, diag + k, left + k, up + k, a + k, b + k, 
+                     count - k, sub, ins, del);
+    }
+
+    __attribute__((target("avx2")))
+    inline void DiagonalStepAVX2(
+            std::uint32_t* out, const std::uint32_t* diag, 
+            const std::uint32_t* left, const std::uint32_t* up, 
+            const std::uint32_t* a, const std::uint32_t* b, std::size_t count,
+            std::uint32_t sub, std::uint32_t ins, std::uint32_t del) noexcept {
+        const __m256i vsub = _mm256_set1_epi32(static_cast<int>(sub));
+        const __m256i vins = _mm256_set1_epi32(static_cast<int>(ins));
+        const __m256i vdel = _mm256_set1_epi32(static_cast<int>(del));
+        std::size_t k = 0;
+        for (; k + 8 <= count; k += 8) {
+            __m256i same = _mm256_cmpeq_epi32(LoadAVX2(a + k), LoadAVX2(b + k));
+            __m256i subCost = _mm256_add_epi32(LoadAVX2(diag + k), 
+                                               _mm256_andnot_si256(same, vsub));
+            __m256i insCost = _mm256_add_epi32(LoadAVX2(left + k), vins);
+            __m256i delCost = _mm256_add_epi32(LoadAVX2(up + k), vdel);
+            __m256i best = _mm256_min_epi32(subCost, 
+                                            _mm256_min_epi32(insCost, delCost));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), best);
+        }
+        DiagonalStep(out + k, diag + k, left + k, up + k, a + k, b + k, 
+                     count - k, sub, ins, del);
+    }
+
+    __attribute__((target("sse4.1")))
+    inline void DiagonalStepSSE41(
+            std::uint16_t* out, const std::uint16_t* diag, 
+            const std::uint16_t* left, const std::uint16_t* up, 
+            const std::uint16_t* a, const std::uint16_t* b, std::size_t count,
+            std::uint16_t sub, std::uint16_t ins, std::uint16_t del) noexcept {
+        const __m128i vsub = _mm_set1_epi16(static_cast<short>(sub));
+        const __m128i vins = _mm_set1_epi16(static_cast<short>(ins));
+        const __m128i vdel = _mm_set1_epi16(static_cast<short>(del));
+        std::size_t k = 0;
+        for (; k + 8 <= count; k += 8) {
+            __m128i same = _mm_cmpeq_epi16(LoadSSE41(a + k), LoadSSE41(b + k));
+            __m128i subCost = _mm_add_epi16(LoadSSE41(diag + k), 
+                                            _mm_andnot_si128(same, vsub));
+            __m128i insCost = _mm_add_epi16(LoadSSE41(left + k), vins);
+            __m128i delCost = _mm_add_epi16(LoadSSE41(up + k), vdel);
+            __m128i best = _mm_min_epu16(subCost, 
+                                         _mm_min_epu16(insCost, delCost));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), best);
+        }
+        DiagonalStep(out + k, diag + k, left + k, up + k, a + k, b + k, 
+                     count - k, sub, ins, del);
+    }
+
+    __attribute__((target("sse4.1")))
+    inline void DiagonalStepSSE41(
+            std::uint32_t* out, const std::uint32_t* diag, 
+            const std::uint32_t* left, const std::uint32_t* up, 
+            const std::uint32_t* a, const std::uint32_t* b, std::size_t count,
+            std::uint32_t sub, std::uint32_t ins, std::uint32_t del) noexcept {
+        const __m128i vsub = _mm_set1_epi32(static_cast<int>(sub));
+        const __m128i vins = _mm_set1_epi32(static_cast<int>(ins));
+        const __m128i vdel = _mm_set1_epi32(static_cast<int>(del));
+        std::size_t k = 0;
+        for (; k + 4 <= count; k += 4) {
+            __m128i same = _mm_cmpeq_epi32(LoadSSE41(a + k), LoadSSE41(b + k));
+            __m128i subCost = _mm_add_epi32(LoadSSE41(diag + k), 
+                                            _mm_andnot_si128(same, vsub));
+            __m128i insCost = _mm_add_epi32(LoadSSE41(left + k), vins);
+            __m128i delCost = _mm_add_epi32(LoadSSE41(up + k), vdel);
+            __m128i best = _mm_min_epi32(subCost, 
+                                         _mm_min_epi32(insCost, delCost));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), best);
+        }
+        DiagonalStep(out + k, diag + k, left + k, up + k, a + k, b + k, 
+                     count - k, sub, ins, del);
+    }
+#endif // LCH_X86_SIMD
+
+    enum class Simd { none, sse41, avx2 };
+
+    inline Simd BestSimd() noexcept {
+        if (Cpu().avx2) return Simd::avx2;
+        if (Cpu().sse41) return Simd::sse41;
+        return Simd::none;
+    }
+
+    // Below this length, setting up the wavefront costs more than it saves.
+    constexpr std::size_t wavefrontMinSize = 24;
+
+    // Converts a sequence to lane values of type Code which compare equal
+    // exactly when the symbols do. Symbols no wider than Code are just cast;
+    // wider ones are numbered by their rank among the distinct symbols of
+    // the sorted reference (1, 2, ...), with symbols not in it numbered 0.
+    // Returns false if there are too many distinct symbols for Code.
+    template<class Code, class InputIt, class Symbol>
+    bool EncodeSymbols(InputIt begin, InputIt end, const Symbol* refBegin,
+                       const Symbol* refEnd, Code* output) {
+        using Unsigned = std::make_unsigned_t<Symbol>;
+        if (sizeof(Symbol) <= sizeof(Code)) {
+            for (InputIt it = begin; it != end; ++it) {
+                *output++ = static_cast<Code>(static_cast<Unsigned>(*it));
+            }
+            return true;
+        }
+        if (static_cast<std::size_t>(refEnd - refBegin)
+                >= std::numeric_limits<Code>::max()) {
+            return false;
+        }
+        for (InputIt it = begin; it != end; ++it) {
+            const Symbol* found = std::lower_bound(refBegin, refEnd, *it);
+            bool present = found != refEnd && *found == *it;
+            *output++ = present ? static_cast<Code>(found - refBegin + 1) : 0;
+        }
+        return true;
+    }
+
+    // Levenshtein distance computed one anti-diagonal at a time, with cells of
+    // type Cell (std::uint16_t or std::uint32_t). Returns false without
+    // computing anything if the distance might not fit in a Cell or if there
+    // are too many distinct symbols to encode.
+    template<class Cell, class InputItA, class InputItB>
+    bool WavefrontDistanceWith(
+            InputItA aBegin, InputItA aEnd, std::size_t sizeA,
+            InputItB bBegin, InputItB bEnd, std::size_t sizeB,
+            const LevenshteinCosts& costs, Simd simd, std::size_t& distance) {
+        // Every cell is at most the cost of deleting all of a and inserting
+        // all of b; intermediate sums add at most one more cost on top. The
+        // 32-bit kernels compare cells as signed integers.
+        constexpr std::size_t cellMax = sizeof(Cell) == 2 ? 
+            std::numeric_limits<std::uint16_t>::max() :
+            std::numeric_limits<std::int32_t>::max();
+        std::size_t maxCost = std::max({costs.sub, costs.ins, costs.del});
+        if (maxCost > cellMax 
+            || sizeA*costs.del + sizeB*costs.ins > cellMax - maxCost) {
+            return false;
+        }
+
+        using Symbol = symbol_t<InputItA>;
+        Symbol* refBegin = nullptr;
+        Symbol* refEnd = nullptr;
+        if (sizeof(Symbol) > sizeof(Cell)) {
+            refBegin = Scratch<Symbol>(ScratchSlot::symbols, sizeA);
+            refEnd = std::copy(aBegin, aEnd, refBegin);
+            std::sort(refBegin, refEnd);
+            refEnd = std::unique(refBegin, refEnd);
+        }
+        Cell* a = Scratch<Cell>(ScratchSlot::a, sizeA);
+        Cell* b = Scratch<Cell>(ScratchSlot::b, sizeB);
+        if (!EncodeSymbols(aBegin, aEnd, refBegin, refEnd, a)
+            || !EncodeSymbols(bBegin, bEnd, refBegin, refEnd, b)) {
+            return false;
+        }
+        std::reverse(b, b + sizeB);
+
+        const std::size_t n = sizeA;
+        const std::size_t m = sizeB;
+        const Cell sub = static_cast<Cell>(costs.sub);
+        const Cell ins = static_cast<Cell>(costs.ins);
+        const Cell del = static_cast<Cell>(costs.del);
+
+        // Diagonal d holds the cells (i, d - i), indexed by i. Cell (i, j)
+        // comes from (i-1, j-1) on diagonal d-2 and from (i, j-1) and 
+        // (i-1, j) on diagonal d-1, and compares a[i-1] with b[j-1], which
+        // is at index m-d+i of the reversed b, so all of these are contiguous
+        // in i.
+        Cell* prev2 = Scratch<Cell>(ScratchSlot::diagonals, 3*(n + 1));
+        Cell* prev1 = prev2 + (n + 1);
+        Cell* cur = prev1 + (n + 1);
+        for (std::size_t d = 0; d <= n + m; ++d) {
+            std::size_t iLow = d > m ? d - m : 0;
+            std::size_t iHigh = std::min(n, d);
+            if (iLow == 0) cur[0] = static_cast<Cell>(d*costs.ins);
+            if (iHigh == d) cur[d] = static_cast<Cell>(d*costs.del);
+
+            std::size_t first = std::max<std::size_t>(iLow, 1);
+            std::size_t last = std::min(iHigh, d - 1);
+            if (d >= 2 && first <= last) {
+                Cell* out = cur + first;
+                const Cell* diag = prev2 + first - 1;
+                const Cell* left = prev1 + first;
+                const Cell* up = prev1 + first - 1;
+                const Cell* aPart = a + first - 1;
+                const Cell* bPart = b + (m - d + first);
+                std::size_t count = last - first + 1;
+                switch (simd) {
+#ifdef LCH_X86_SIMD
+                  case Simd::avx2:
+                    DiagonalStepAVX2(out, diag, left, up, aPart, bPart, count,
+                                     sub, ins, del);
+                    break;
+                  case Simd::sse41:
+                    DiagonalStepSSE41(out, diag, left, up, aPart, bPart, count,
+                                      sub, ins, del);
+                    break;
+#endif
+                  default:
+                    DiagonalStep(out, diag, left, up, aPart, bPart, count,
+                                 sub, ins, del);
+                }
+            }
+
+            Cell* oldest = prev2;
+            prev2 = prev1;
+            prev1 = cur;
+            cur = oldest;
+        }
+
+        distance = prev1[n];
+        return true;
+    }
+
+    // The "one-row exhaustive" method, with cells of type Cell, which must be
+    // able to hold CellBound(sizeA, sizeB, costs).
+    template<class Cell, class InputItA, class InputItB>
+    std::size_t OneRowDistance(InputItA aBegin, InputItA aEnd, 
+                               InputItB bBegin, InputItB bEnd, 
+                               std::size_t sizeB, 
+                               const LevenshteinCosts& costs) {
+        const Cell sub = static_cast<Cell>(costs.sub);
+        const Cell ins = static_cast<Cell>(costs.ins);
+        const Cell del = static_cast<Cell>(costs.del);
+
+        Cell* row = Scratch<Cell>(ScratchSlot::row, sizeB + 1);
+        for (std::size_t j = 0; j <= sizeB; ++j) {
+            row[j] = static_cast<Cell>(j*costs.ins);
+        }
+
+        for (InputItA aIt = aBegin; aIt != aEnd; ++aIt) {
+            Cell aboveLeft = row[0];
+            row[0] = static_cast<Cell>(row[0] + del);
+
+            std::size_t i = 0;
+            for (InputItB bIt = bBegin; bIt != bEnd; ++bIt) {
+                Cell subCost = static_cast<Cell>(
+                        aboveLeft + (*aIt == *bIt ? 0 : sub));
+                Cell insCost = static_cast<Cell>(row[i] + ins);
+                Cell delCost = static_cast<Cell>(row[i+1] + del);
+                aboveLeft = row[i+1];
+                row[i+1] = std::min({subCost, insCost, delCost});
+                i += 1;
+            }
+        }
+
+        return row[sizeB];
+    }
+
+    // Tries 16-bit cells first, since twice as many fit in a register, then
+    // 32-bit cells. Returns false (so the caller should use the one-row
+    // method) if neither will do, or if no SIMD is available, in which case the
+    // one-row method is faster anyway.
+    template<class InputItA, class InputItB>
+    bool WavefrontDistance(
+            InputItA aBegin, InputItA aEnd, std::size_t sizeA,
+            InputItB bBegin, InputItB bEnd, std::size_t sizeB,
+            const LevenshteinCosts& costs, Simd simd, std::size_t& distance) {
+        if (simd == Simd::none) return false;
+        return WavefrontDistanceWith<std::uint16_t>(aBegin, aEnd, sizeA, 
+                    bBegin, bEnd, sizeB, costs, simd, distance)
+            || WavefrontDistanceWith<std::uint32_t>(aBegin, aEnd, sizeA, 
+                    bBegin, bEnd, sizeB, costs, simd, distance);
+    }
+} // namespace Detail
+
+
 template<class InputItA, class InputItB>
 std::size_t levenshtein_distance(
         InputItA aBegin, InputItA aEnd, InputItB bBegin, InputItB bEnd,
         const LevenshteinCosts& costs = {}) noexcept {
     std::size_t sizeA = std::distance(aBegin, aEnd);
     std::size_t sizeB = std::distance(bBegin, bEnd);
+    Detail::TrimCommonEnds(aBegin, aEnd, sizeA, bBegin, bEnd, sizeB);
     if (sizeA == 0) return sizeB*costs.ins;
     if (sizeB == 0) return sizeA*costs.del;
 
-    std::vector<std::size_t> row(sizeB + 1);
-    for (std::size_t j = 0; j < row.size(); ++j) row[j] = j*costs.ins;
+    if constexpr (Detail::integral_symbols<InputItA, InputItB>) {
+        if (costs.sub == costs.ins && costs.ins == costs.del) {
+            return costs.sub*Detail::BitParallelDistance(aBegin, aEnd, sizeA, 
+                                                         bBegin, bEnd, sizeB);
+        }
+        if (std::min(sizeA, sizeB) >= Detail::wavefrontMinSize) {
+            std::size_t distance;
+            if (Detail::WavefrontDistance(aBegin, aEnd, sizeA, bBegin, bEnd,
+                                          sizeB, costs, Detail::BestSimd(),
+                                          distance)) {
+                return distance;
+            }
+        }
+    }
+
+    return Detail::WithCellsFor(Detail::CellBound(sizeA, sizeB, costs), 
+            [&](auto cell){
+                return Detail::OneRowDistance<decltype(cell)>(
+                        aBegin, aEnd, bBegin, bEnd, sizeB, costs);
+            });
+}
+
+namespace Detail {
+    // The cheapest way to get from one end of diagonal j - i = k of the DP
+    // matrix to the other end of diagonal k + offset, i.e. offset insertions
+    // or -offset deletions.
+    inline std::size_t DiagonalShiftCost(
+            std::ptrdiff_t offset, const LevenshteinCosts& costs) noexcept {
+        return offset >= 0 ? offset*costs.ins : -offset*costs.del;
+    }
+
+    // Ukkonen's banded version of the one-row method. Any path through cell 
+    // (i, j) costs at least DiagonalShiftCost(j - i) to get there and
+    // DiagonalShiftCost((m - n) - (j - i)) to get from there to the end, so 
+    // only the diagonals kLow <= j - i <= kHigh where that's at most maxDist
+    // are computed, with everything outside them treated as maxDist + 1.
+    // Every path passes through every row, so once a whole row is over
+    // maxDist so is the distance, and we stop.
+    template<class Cell, class InputItA, class InputItB>
+    std::size_t BandedDistance(
+            InputItA aBegin, InputItA aEnd, InputItB bBegin, 
+            std::size_t sizeB, std::ptrdiff_t kLow, std::ptrdiff_t kHigh, 
+            std::size_t maxDist, const LevenshteinCosts& costs) {
+        const std::ptrdiff_t m = sizeB;
+        const Cell cap = static_cast<Cell>(maxDist + 1);
+        const Cell sub = static_cast<Cell>(costs.sub);
+        const Cell ins = static_cast<Cell>(costs.ins);
+        const Cell del = static_cast<Cell>(costs.del);
 
-    for (InputItA aIt = aBegin; aIt != aEnd; ++aIt) {
-        std::size_t aboveLeft = row[0];
-        row[0] += costs.del;
+        Cell* row = Scratch<Cell>(ScratchSlot::row, sizeB + 1);
+        std::fill(row, row + sizeB + 1, cap);
+        for (std::ptrdiff_t j = 0; j <= std::min(m, kHigh); ++j) {
+            row[j] = static_cast<Cell>(std::min<std::size_t>(j*costs.ins, cap));
+        }
 
-        std::size_t i = 0;
-        for (InputItB bIt = bBegin; bIt != bEnd; ++bIt) {
-            auto subCost = aboveLeft + (*aIt == *bIt ? 0 : costs.sub);
-            auto insCost = row[i] + costs.ins;
-            auto delCost = row[i+1] + costs.del;
-            aboveLeft = row[i+1];
-            row[i+1] = std::min({subCost, insCost, delCost});
+        // bLow is b[max(low, 1) - 1], the symbol for the first column of the
+        // band other than column 0.
+        InputItB bLow = bBegin;
+        std::ptrdiff_t i = 0;
+        for (InputItA aIt = aBegin; aIt != aEnd; ++aIt) {
             i += 1;
+            std::ptrdiff_t low = std::max<std::ptrdiff_t>(0, i + kLow);
+            std::ptrdiff_t high = std::min(m, i + kHigh);
+            if (low >= 2) ++bLow;
+
+            Cell aboveLeft = row[low > 0 ? low - 1 : 0];
+            Cell left = cap;
+            Cell rowMin = cap;
+            if (low == 0) {
+                row[0] = std::min(static_cast<Cell>(row[0] + del), cap);
+                left = rowMin = row[0];
+            }
+
+            InputItB bIt = bLow;
+            for (std::ptrdiff_t j = std::max<std::ptrdiff_t>(low, 1); 
+                 j <= high; ++j, ++bIt) {
+                Cell subCost = static_cast<Cell>(
+                        aboveLeft + (*aIt == *bIt ? 0 : sub));
+                Cell insCost = static_cast<Cell>(left + ins);
+                Cell delCost = static_cast<Cell>(row[j] + del);
+                aboveLeft = row[j];
+                row[j] = left = std::min({subCost, insCost, delCost, cap});
+                rowMin = std::min(rowMin, left);
+            }
+            if (rowMin > maxDist) return cap;
+        }
+
+        return row[sizeB];
+    }
+} // namespace Detail
+
+// Like levenshtein_distance, but only exact up to maxDist: any distance
+// greater than that is reported as maxDist + 1. This lets the work be limited
+// to a band around the main diagonal and stopped as soon as it's clear that
+// the distance is too great (e.g. because the lengths differ by too much), so
+// it's much faster than levenshtein_distance when maxDist is small.
+template<class InputItA, class InputItB>
+std::size_t levenshtein_distance_bounded(
+        InputItA aBegin, InputItA aEnd, InputItB bBegin, InputItB bEnd,
+        std::size_t maxDist, const LevenshteinCosts& costs = {}) noexcept {
+    std::size_t sizeA = std::distance(aBegin, aEnd);
+    std::size_t sizeB = std::distance(bBegin, bEnd);
+    Detail::TrimCommonEnds(aBegin, aEnd, sizeA, bBegin, bEnd, sizeB);
+    std::ptrdiff_t n = sizeA;
+    std::ptrdiff_t m = sizeB;
+
+    // Going from diagonal 0 (the start) to diagonal m - n (the end) is the
+    // least any path can cost; every diagonal further out costs ins + del more.
+    std::size_t minCost = Detail::DiagonalShiftCost(m - n, costs);
+    if (minCost > maxDist) return maxDist + 1;
+    std::size_t step = costs.ins + costs.del;
+    std::ptrdiff_t spare = step == 0 ? n + m : 
+        static_cast<std::ptrdiff_t>(std::min<std::size_t>(
+                (maxDist - minCost)/step, n + m));
+    std::ptrdiff_t kLow = std::max(-n, std::min<std::ptrdiff_t>(0, m - n) 
+                                       - spare);
+    std::ptrdiff_t kHigh = std::min(m, std::max<std::ptrdiff_t>(0, m - n) 
+                                       + spare);
+    std::size_t width = kHigh - kLow + 1;
+
+    // The bit-parallel method takes fewer operations unless the band is very
+    // narrow, and can give up early too.
+    if constexpr (Detail::integral_symbols<InputItA, InputItB>) {
+        std::size_t blocks = (std::min(n, m) + 63)/64;
+        if (costs.sub == costs.ins && costs.ins == costs.del 
+            && costs.sub > 0 && width >= 4*blocks) {
+            std::size_t maxEdits = maxDist/costs.sub;
+            std::size_t edits = Detail::BitParallelDistance(aBegin, aEnd, n, 
+                    bBegin, bEnd, m, maxEdits);
+            return edits > maxEdits ? maxDist + 1 : edits*costs.sub;
         }
     }
+    // Banding doesn't help if the band is the whole matrix, or if the distance
+    // can't be over maxDist anyway.
+    std::size_t maxCost = std::max({costs.sub, costs.ins, costs.del});
+    std::size_t cellBound = Detail::CellBound(n, m, costs);
+    if ((kLow == -n && kHigh == m) || cellBound - maxCost <= maxDist) {
+        std::size_t distance = levenshtein_distance(aBegin, aEnd, bBegin, bEnd,
+                                                    costs);
+        return distance > maxDist ? maxDist + 1 : distance;
+    }
 
-    return row.back();
+    // Cells never go past maxDist + 1 plus one more cost.
+    return Detail::WithCellsFor(maxDist + 1 + maxCost, [&](auto cell){
+        return Detail::BandedDistance<decltype(cell)>(
+                aBegin, aEnd, bBegin, m, kLow, kHigh, maxDist, costs);
+    });
+}
+
+namespace Detail {
+    // One step of Hyyro's bit-parallel algorithm for the optimal string
+    // alignment distance, which extends AdvanceBlock with transpositions: Tr
+    // has a bit set for each row where the text symbol before this one and
+    // this one could be swapped to match the pattern. D0 holds the diagonal
+    // zero-differences from the previous step, and is updated.
+    inline int AdvanceBlockOSA(std::uint64_t& Pv, std::uint64_t& Mv, 
+                               std::uint64_t& D0, std::uint64_t Eq, 
+                               std::uint64_t Tr, int hin, 
+                               std::uint64_t highBit) noexcept {
+        std::uint64_t hinIsNeg = static_cast<std::uint64_t>(hin < 0);
+        std::uint64_t X = Eq | hinIsNeg;
+        D0 = (((X & Pv) + Pv) ^ Pv) | X | Mv | Tr;
+        std::uint64_t Ph = Mv | ~(D0 | Pv);
+        std::uint64_t Mh = D0 & Pv;
+        int hout = static_cast<int>((Ph & highBit) != 0) 
+                 - static_cast<int>((Mh & highBit) != 0);
+        Ph = (Ph << 1) | static_cast<std::uint64_t>(hin > 0);
+        Mh = (Mh << 1) | hinIsNeg;
+        Pv = Mh | ~(D0 | Ph);
+        Mv = Ph & D0;
+        return hout;
+    }
+
+    // Unit-cost optimal string alignment distance between the pattern and
+    // [textBegin, textEnd), giving up like MyersDistance once it's clear that
+    // it's more than maxDist.
+    template<class Masks, class InputIt>
+    std::size_t MyersOSADistance(
+            const Masks& pattern, InputIt textBegin, InputIt textEnd,
+            std::size_t maxDist = std::numeric_limits<std::size_t>::max()) {
+        std::size_t size = pattern.Size();
+        std::size_t remaining = std::distance(textBegin, textEnd);
+        if (size == 0) return std::min(remaining, maxDist + 1);
+
+        std::size_t blocks = pattern.Blocks();
+        std::uint64_t lastBit = std::uint64_t(1) << ((size - 1) % 64);
+        constexpr std::uint64_t highBit = std::uint64_t(1) << 63;
+        std::size_t score = size;
+
+        // Pv, Mv, D0, and the previous text symbol's masks for each block
+        std::uint64_t* state = Scratch<std::uint64_t>(ScratchSlot::row, 
+                                                      4*blocks);
+        std::uint64_t* Pv = state;
+        std::uint64_t* Mv = Pv + blocks;
+        std::uint64_t* D0 = Mv + blocks;
+        std::uint64_t* EqBefore = D0 + blocks;
+        std::fill(Pv, Pv + blocks, ~std::uint64_t(0));
+        std::fill(Mv, Mv + 3*blocks, 0);
+
+        for (InputIt it = textBegin; it != textEnd; ++it) {
+            std::size_t row = pattern.Row(*it);
+            int carry = 1;
+            // a transposition can span two blocks, so the top bit of the 
+            // previous block's candidates carries into this one
+            std::uint64_t trCarry = 0;
+            for (std::size_t k = 0; k < blocks; ++k) {
+                std::uint64_t Eq = pattern.Mask(row, k);
+                std::uint64_t candidates = ~D0[k] & Eq;
+                std::uint64_t Tr = ((candidates << 1) | trCarry) & EqBefore[k];
+                trCarry = candidates >> 63;
+                carry = AdvanceBlockOSA(Pv[k], Mv[k], D0[k], Eq, Tr, carry,
+                                        k + 1 < blocks ? highBit : lastBit);
+                EqBefore[k] = Eq;
+            }
+            score += carry;
+            remaining -= 1;
+            if (score > maxDist && score - maxDist > remaining) {
+                return maxDist + 1;
+            }
+        }
+        return score > maxDist ? maxDist + 1 : score;
+    }
+
+    // The optimal string alignment distance, which is the Levenshtein distance
+    // plus swaps of adjacent symbols, as long as no symbol is edited more than
+    // once. It needs the two rows before the current one, and the symbols
+    // before the current ones on each side. Every path through the DP matrix
+    // passes through row i or jumps over it from row i - 1, so once both are
+    // over maxDist, this gives up and returns maxDist + 1.
+    template<class Cell, class InputItA, class InputItB>
+    std::size_t OSADistanceRows(InputItA aBegin, InputItA aEnd, 
+                                InputItB bBegin, InputItB bEnd, 
+                                std::size_t sizeB, std::size_t maxDist,
+                                const LevenshteinCosts& costs) {
+        Cell* rows = Scratch<Cell>(ScratchSlot::row, 3*(sizeB + 1));
+        Cell* before = rows;
+        Cell* above = before + (sizeB + 1);
+        Cell* current = above + (sizeB + 1);
+        for (std::size_t j = 0; j <= sizeB; ++j) {
+            above[j] = static_cast<Cell>(j*costs.ins);
+        }
+        std::size_t aboveMin = 0;
+
+        InputItA aPrev = aEnd;
+        for (InputItA aIt = aBegin; aIt != aEnd; aPrev = aIt, ++aIt) {
+            current[0] = static_cast<Cell>(above[0] + costs.del);
+            std::size_t currentMin = current[0];
+            InputItB bPrev = bEnd;
+            std::size_t j = 1;
+            for (InputItB bIt = bBegin; bIt != bEnd; bPrev = bIt, ++bIt, ++j) {
+                bool same = *aIt == *bIt;
+                std::size_t best = std::min({
+                    above[j-1] + (same ? 0 : costs.sub),
+                    current[j-1] + costs.ins,
+                    above[j] + costs.del});
+                if (!same && aPrev != aEnd && bPrev != bEnd 
+                    && *aIt == *bPrev && *aPrev == *bIt) {
+                    best = std::min(best, before[j-2] + costs.trans);
+                }
+                current[j] = static_cast<Cell>(best);
+                currentMin = std::min(currentMin, best);
+            }
+            if (currentMin > maxDist && aboveMin > maxDist) return maxDist + 1;
+
+            aboveMin = currentMin;
+            Cell* oldest = before;
+            before = above;
+            above = current;
+            current = oldest;
+        }
+
+        std::size_t distance = above[sizeB];
+        return distance > maxDist ? maxDist + 1 : distance;
+    }
+
+    // Numbers the symbols of both sides densely (0, 1, ...) so that they can
+    // index an array, writing the numbers to aIds and bIds and returning how
+    // many there are. This needs the symbols to be ordered by <.
+    template<class InputItA, class InputItB>
+    std::size_t NumberSymbols(InputItA aBegin, InputItA aEnd, 
+                              InputItB bBegin, InputItB bEnd,
+                              std::uint32_t* aIds, std::uint32_t* bIds) {
+        using Symbol = std::common_type_t<symbol_t<InputItA>, 
+                                          symbol_t<InputItB>>;
+        std::vector<Symbol> alphabet(aBegin, aEnd);
+        alphabet.insert(alphabet.end(), bBegin, bEnd);
+        std::sort(alphabet.begin(), alphabet.end());
+        alphabet.erase(std::unique(alphabet.begin(), alphabet.end()),
+                       alphabet.end());
+        auto id = [&](const Symbol& symbol){
+            return static_cast<std::uint32_t>(std::lower_bound(
+                    alphabet.begin(), alphabet.end(), symbol) 
+                - alphabet.begin());
+        };
+        for (InputItA it = aBegin; it != aEnd; ++it) *aIds++ = id(*it);
+        for (InputItB it = bBegin; it != bEnd; ++it) *bIds++ = id(*it);
+        return alphabet.size();
+    }
+
+    // Lowrance and Wagner's algorithm for the unrestricted Damerau-Levenshtein
+    // distance: when a[i-1] and b[j-1] are the ends of a transposition, the 
+    // other ends are the last a[k-1] == b[j-1] before row i and the last 
+    // b[l-1] == a[i-1] before column j, with everything between them deleted
+    // or inserted. The DP matrix has an extra row and column of "infinity"
+    // (which must fit in a Cell) for when there's no such symbol, and all of
+    // it is kept, since a transposition can reach back any number of rows.
+    // Sums stop at infinity rather than overflowing, since with huge costs it
+    // is SIZE_MAX.
+    template<class Cell, class InputItA, class InputItB>
+    std::size_t LowranceWagnerDistance(
+            InputItA aBegin, InputItA aEnd, std::size_t sizeA, 
+            InputItB bBegin, InputItB bEnd, std::size_t sizeB, 
+            std::size_t infinity, const LevenshteinCosts& costs) {
+        std::uint32_t* aIds = Scratch<std::uint32_t>(ScratchSlot::a, sizeA);
+        std::uint32_t* bIds = Scratch<std::uint32_t>(ScratchSlot::b, sizeB);
+        std::size_t alphabetSize = NumberSymbols(aBegin, aEnd, bBegin, bEnd,
+                                                 aIds, bIds);
+        std::vector<std::size_t> lastRow(alphabetSize, 0);
+
+        // not scratch memory, since it could be huge and we don't want each
+        // thread to hang on to it
+        const std::size_t width = sizeB + 2;
+        std::vector<Cell> H((sizeA + 2)*width);
+        auto at = [&](std::size_t i, std::size_t j) -> Cell& { 
+            return H[i*width + j]; 
+        };
+        auto plus = [infinity](std::size_t x, std::size_t y) {
+            return y >= infinity - std::min(x, infinity) ? infinity : x + y;
+        };
+        auto times = [infinity](std::size_t count, std::size_t cost) {
+            return cost != 0 && count > infinity/cost ? infinity : count*cost;
+        };
+        at(0, 0) = static_cast<Cell>(infinity);
+        for (std::size_t i = 0; i <= sizeA; ++i) {
+            at(i + 1, 0) = static_cast<Cell>(infinity);
+            at(i + 1, 1) = static_cast<Cell>(times(i, costs.del));
+        }
+        for (std::size_t j = 0; j <= sizeB; ++j) {
+            at(0, j + 1) = static_cast<Cell>(infinity);
+            at(1, j + 1) = static_cast<Cell>(times(j, costs.ins));
+        }
+
+        for (std::size_t i = 1; i <= sizeA; ++i) {
+            std::size_t lastColumn = 0;
+            for (std::size_t j = 1; j <= sizeB; ++j) {
+                std::size_t k = lastRow[bIds[j-1]];
+                std::size_t l = lastColumn;
+                bool same = aIds[i-1] == bIds[j-1];
+                if (same) lastColumn = j;
+                std::size_t best = std::min({
+                    plus(at(i, j), same ? 0 : costs.sub),
+                    plus(at(i + 1, j), costs.ins),
+                    plus(at(i, j + 1), costs.del),
+                    plus(plus(at(k, l), times(i - k - 1, costs.del)),
+                         plus(costs.trans, times(j - l - 1, costs.ins)))});
+                at(i + 1, j + 1) = static_cast<Cell>(best);
+            }
+            lastRow[aIds[i-1]] = i;
+        }
+        return at(sizeA + 1, sizeB + 1);
+    }
+} // namespace Detail
+
+// The optimal string alignment distance between a and b: the Levenshtein
+// distance, but also allowing two adjacent symbols to be swapped for
+// costs.trans, as long as neither is then edited again. Arguments are as for
+// levenshtein_distance_bounded: anything more than maxDist is reported as
+// maxDist + 1, and the computation stops as soon as that's certain. With equal
+// costs (including trans) and integral symbols of the same type, this uses
+// Hyyro's bit-parallel version of Myers' algorithm.
+template<class InputItA, class InputItB>
+std::size_t osa_distance_bounded(
+        InputItA aBegin, InputItA aEnd, InputItB bBegin, InputItB bEnd,
+        std::size_t maxDist, const LevenshteinCosts& costs = {}) {
+    std::size_t sizeA = std::distance(aBegin, aEnd);
+    std::size_t sizeB = std::distance(bBegin, bEnd);
+    Detail::TrimCommonEnds(aBegin, aEnd, sizeA, bBegin, bEnd, sizeB);
+
+    std::size_t minCost = sizeA > sizeB ? (sizeA - sizeB)*costs.del 
+                                        : (sizeB - sizeA)*costs.ins;
+    if (minCost > maxDist) return maxDist + 1;
+    if (sizeA == 0 || sizeB == 0) return minCost;
+
+    if constexpr (Detail::integral_symbols<InputItA, InputItB>) {
+        if (costs.sub == costs.ins && costs.ins == costs.del 
+            && costs.del == costs.trans && costs.sub > 0) {
+            // with equal costs the distance is symmetric, so the shorter side
+            // can be the pattern
+            using Symbol = Detail::symbol_t<InputItA>;
+            std::size_t maxEdits = maxDist/costs.sub;
+            std::size_t edits = sizeA <= sizeB ?
+                Detail::MyersOSADistance(
+                        Detail::PatternMasks<Symbol>(aBegin, aEnd), 
+                        bBegin, bEnd, maxEdits) :
+                Detail::MyersOSADistance(
+                        Detail::PatternMasks<Symbol>(bBegin, bEnd), 
+                        aBegin, aEnd, maxEdits);
+            return edits > maxEdits ? maxDist + 1 : edits*costs.sub;
+        }
+    }
+
+    std::size_t cellBound = Detail::CellBound(sizeA, sizeB, costs);
+    cellBound = cellBound > std::numeric_limits<std::size_t>::max() - costs.trans
+              ? std::numeric_limits<std::size_t>::max() 
+              : cellBound + costs.trans;
+    return Detail::WithCellsFor(cellBound, [&](auto cell){
+        return Detail::OSADistanceRows<decltype(cell)>(
+                aBegin, aEnd, bBegin, bEnd, sizeB, maxDist, costs);
+    });
+}
+
+// osa_distance_bounded without a bound.
+template<class InputItA, class InputItB>
+std::size_t osa_distance(
+        InputItA aBegin, InputItA aEnd, InputItB bBegin, InputItB bEnd,
+        const LevenshteinCosts& costs = {}) {
+    return osa_distance_bounded(aBegin, aEnd, bBegin, bEnd, 
+                                std::numeric_limits<std::size_t>::max() - 1, 
+                                costs);
+}
+
+// The unrestricted Damerau-Levenshtein distance between a and b: like the
+// optimal string alignment distance, but symbols which have been swapped can
+// also have others inserted between them (so "CA" to "ABC" is a swap and an
+// insertion, rather than three edits). Arguments are as for
+// levenshtein_distance, but the symbols also need to be ordered by <. This is
+// only a true edit distance if 2*trans >= ins + del (which is the case for
+// the default costs), and it takes O(size(a)*size(b)) memory, unlike the
+// other functions here.
+template<class InputItA, class InputItB>
+std::size_t damerau_levenshtein_distance(
+        InputItA aBegin, InputItA aEnd, InputItB bBegin, InputItB bEnd,
+        const LevenshteinCosts& costs = {}) {
+    std::size_t sizeA = std::distance(aBegin, aEnd);
+    std::size_t sizeB = std::distance(bBegin, bEnd);
+    Detail::TrimCommonEnds(aBegin, aEnd, sizeA, bBegin, bEnd, sizeB);
+    if (sizeA == 0) return sizeB*costs.ins;
+    if (sizeB == 0) return sizeA*costs.del;
+
+    // Every cell is at most the Levenshtein bound, which can also act as
+    // infinity.
+    std::size_t infinity = Detail::CellBound(sizeA, sizeB, costs);
+    return Detail::WithCellsFor(infinity, [&](auto cell){
+        return Detail::LowranceWagnerDistance<decltype(cell)>(
+                aBegin, aEnd, sizeA, bBegin, bEnd, sizeB, infinity, costs);
+    });
 }
 
 template<class Container>
@@ -165,4 +1277,125 @@ std::size_t levenshtein_distance(
     return levenshtein_distance(aBegin, aEnd, bBegin, bEnd, costs);
 }
 
+template<class ContainerA, class InputItB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true>
+std::size_t levenshtein_distance_bounded(
+        const ContainerA& a, InputItB bBegin, InputItB bEnd, 
+        std::size_t maxDist, const LevenshteinCosts& costs = {}) noexcept {
+    auto [aBegin, aEnd] = get_iterators(a);
+    return levenshtein_distance_bounded(aBegin, aEnd, bBegin, bEnd, maxDist, 
+                                        costs);
+}
+
+template<class InputItA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t levenshtein_distance_bounded(
+        InputItA aBegin, InputItA aEnd, const ContainerB& b, 
+        std::size_t maxDist, const LevenshteinCosts& costs = {}) noexcept {
+    auto [bBegin, bEnd] = get_iterators(b);
+    return levenshtein_distance_bounded(aBegin, aEnd, bBegin, bEnd, maxDist, 
+                                        costs);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t levenshtein_distance_bounded(
+        const ContainerA& a, const ContainerB& b, std::size_t maxDist,
+        const LevenshteinCosts& costs = {}) noexcept {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return levenshtein_distance_bounded(aBegin, aEnd, bBegin, bEnd, maxDist, 
+                                        costs);
+}
+
+template<class ContainerA, class InputItB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true>
+std::size_t osa_distance_bounded(
+        const ContainerA& a, InputItB bBegin, InputItB bEnd,
+        std::size_t maxDist, const LevenshteinCosts& costs = {}) {
+    auto [aBegin, aEnd] = get_iterators(a);
+    return osa_distance_bounded(aBegin, aEnd, bBegin, bEnd, maxDist, costs);
+}
+
+template<class InputItA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t osa_distance_bounded(
+        InputItA aBegin, InputItA aEnd, const ContainerB& b,
+        std::size_t maxDist, const LevenshteinCosts& costs = {}) {
+    auto [bBegin, bEnd] = get_iterators(b);
+    return osa_distance_bounded(aBegin, aEnd, bBegin, bEnd, maxDist, costs);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t osa_distance_bounded(
+        const ContainerA& a, const ContainerB& b, std::size_t maxDist,
+        const LevenshteinCosts& costs = {}) {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return osa_distance_bounded(aBegin, aEnd, bBegin, bEnd, maxDist, costs);
+}
+
+template<class ContainerA, class InputItB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true>
+std::size_t osa_distance(
+        const ContainerA& a, InputItB bBegin, InputItB bEnd,
+        const LevenshteinCosts& costs = {}) {
+    auto [aBegin, aEnd] = get_iterators(a);
+    return osa_distance(aBegin, aEnd, bBegin, bEnd, costs);
+}
+
+template<class InputItA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t osa_distance(
+        InputItA aBegin, InputItA aEnd, const ContainerB& b,
+        const LevenshteinCosts& costs = {}) {
+    auto [bBegin, bEnd] = get_iterators(b);
+    return osa_distance(aBegin, aEnd, bBegin, bEnd, costs);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t osa_distance(
+        const ContainerA& a, const ContainerB& b,
+        const LevenshteinCosts& costs = {}) {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return osa_distance(aBegin, aEnd, bBegin, bEnd, costs);
+}
+
+template<class ContainerA, class InputItB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true>
+std::size_t damerau_levenshtein_distance(
+        const ContainerA& a, InputItB bBegin, InputItB bEnd,
+        const LevenshteinCosts& costs = {}) {
+    auto [aBegin, aEnd] = get_iterators(a);
+    return damerau_levenshtein_distance(aBegin, aEnd, bBegin, bEnd, costs);
+}
+
+template<class InputItA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t damerau_levenshtein_distance(
+        InputItA aBegin, InputItA aEnd, const ContainerB& b,
+        const LevenshteinCosts& costs = {}) {
+    auto [bBegin, bEnd] = get_iterators(b);
+    return damerau_levenshtein_distance(aBegin, aEnd, bBegin, bEnd, costs);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t damerau_levenshtein_distance(
+        const ContainerA& a, const ContainerB& b,
+        const LevenshteinCosts& costs = {}) {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return damerau_levenshtein_distance(aBegin, aEnd, bBegin, bEnd, costs);
+}
+
 } // namespace LCH
+
+#endif // LCH_LEVENSHTEIN_HPP
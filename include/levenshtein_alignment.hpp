@@ -0,0 +1,318 @@
+///////////////////////////////////////////////////////////////////////////////
+// levenshtein_alignment.hpp: recovers the edits behind a Levenshtein distance,
+// not just their total cost, in space linear in the length of the inputs.
+//
+// std::vector<LCH::LevenshteinEdit> edits
+//         = LCH::levenshtein_edit_script(a, b, costs);
+// std::vector<LCH::LevenshteinEdit> edits
+//         = LCH::levenshtein_edit_script(aBegin, aEnd, bBegin, bEnd, costs);
+//
+// The edits turn a into b, in order from the start of both. Each one has a
+// type (match, sub, ins, or del) and the positions in a and b it applies to;
+// for an insertion, aIndex is the position in a the new symbol goes before,
+// and for a deletion, bIndex is the position in b the deleted symbol would
+// have been before. The total cost of the edits (with the same costs) is
+// levenshtein_distance(a, b, costs). If there are several cheapest scripts,
+// which one you get is unspecified. The iterators must be random-access.
+//
+// This uses Hirschberg's algorithm: the DP is run forwards over the first half
+// of the longer input and backwards over the second half, one row (as long as
+// the shorter input) at a time, to find where the best alignment crosses from
+// one half to the other, and then each side is solved separately. This takes
+// twice as long as filling in the DP matrix, but only needs a couple of rows
+// at a time, which makes it possible to diff sequences that are far too long
+// for the whole matrix to fit in memory. (Pieces small enough that their
+// matrix is cheap are solved directly.)
+//
+// If you pass a ThreadPool, the first few splits are done by running the
+// forward and backward halves on it in parallel, and the resulting pieces are
+// then solved in parallel too. The result is the same as without it. Like
+// levenshtein_search, this waits for its tasks, so don't call it from a task
+// on the same pool.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_LEVENSHTEIN_ALIGNMENT_HPP
+#define LCH_LEVENSHTEIN_ALIGNMENT_HPP
+
+#include "levenshtein.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <future>
+#include <iterator>
+#include <algorithm> // min, reverse
+#include <type_traits>
+
+namespace LCH {
+
+enum class EditType { match, sub, ins, del };
+
+struct LevenshteinEdit {
+    EditType type;
+    std::size_t aIndex;
+    std::size_t bIndex;
+};
+
+namespace Detail {
+    // The part of the alignment problem pairing a[aFirst, aLast) with
+    // b[bFirst, bLast).
+    struct AlignmentPiece {
+        std::size_t aFirst;
+        std::size_t aLast;
+        std::size_t bFirst;
+        std::size_t bLast;
+    };
+
+    // Pieces with no more DP cells than this are solved with the full matrix.
+    constexpr std::size_t alignmentDirectCells = 1 << 14;
+
+    // Fills row (of size(b) + 1) with the costs of aligning all of a with each
+    // prefix of b; i.e. the last row of the DP matrix.
+    template<class RandomItA, class RandomItB>
+    void LastDPRow(RandomItA aBegin, RandomItA aEnd,
+                   RandomItB bBegin, RandomItB bEnd,
+                   const LevenshteinCosts& costs, std::size_t* row) {
+        std::size_t sizeB = bEnd - bBegin;
+        for (std::size_t j = 0; j <= sizeB; ++j) row[j] = j*costs.ins;
+        for (RandomItA aIt = aBegin; aIt != aEnd; ++aIt) {
+            std::size_t aboveLeft = row[0];
+            row[0] += costs.del;
+            for (std::size_t j = 0; j < sizeB; ++j) {
+                std::size_t subCost = aboveLeft
+                                    + (*aIt == bBegin[j] ? 0 : costs.sub);
+                aboveLeft = row[j+1];
+                row[j+1] = std::min({subCost, row[j] + costs.ins,
+                                     row[j+1] + costs.del});
+            }
+        }
+    }
+
+    // Where the cheapest alignment of a piece crosses the middle row: returns
+    // j such that a[aFirst, middle) goes with b[bFirst, j) and the rest with
+    // the rest. The forward and backward rows are independent, so with a
+    // pool, the forward one is computed on it while this thread does the
+    // other.
+    template<class RandomItA, class RandomItB>
+    std::size_t SplitPoint(RandomItA a, RandomItB b,
+                           const AlignmentPiece& piece, std::size_t middle,
+                           const LevenshteinCosts& costs, ThreadPool* pool) {
+        std::size_t width = piece.bLast - piece.bFirst + 1;
+        std::vector<std::size_t> forward(width);
+        auto computeForward = [&](){
+            LastDPRow(a + piece.aFirst, a + middle, b + piece.bFirst,
+                      b + piece.bLast, costs, forward.data());
+        };
+        std::future<void> forwardDone;
+        if (pool != nullptr) {
+            forwardDone = pool->AddTask(computeForward);
+        } else {
+            computeForward();
+        }
+
+        using ReverseA = std::reverse_iterator<RandomItA>;
+        using ReverseB = std::reverse_iterator<RandomItB>;
+        std::size_t* backward = Scratch<std::size_t>(ScratchSlot::row, width);
+        LastDPRow(ReverseA(a + piece.aLast), ReverseA(a + middle),
+                  ReverseB(b + piece.bLast), ReverseB(b + piece.bFirst),
+                  costs, backward);
+        if (pool != nullptr) forwardDone.get();
+
+        std::size_t best = 0;
+        for (std::size_t j = 1; j < width; ++j) {
+            if (forward[j] + backward[width - 1 - j]
+                < forward[best] + backward[width - 1 - best]) {
+                best = j;
+            }
+        }
+        return piece.bFirst + best;
+    }
+
+    // Solves a piece with the whole DP matrix, appending its edits to edits.
+    template<class RandomItA, class RandomItB>
+    void AlignDirectly(RandomItA a, RandomItB b, const AlignmentPiece& piece,
+                       const LevenshteinCosts& costs,
+                       std::vector<LevenshteinEdit>& edits) {
+        std::size_t n = piece.aLast - piece.aFirst;
+        std::size_t m = piece.bLast - piece.bFirst;
+        std::vector<std::size_t> d((n + 1)*(m + 1));
+        auto at = [&](std::size_t i, std::size_t j) -> std::size_t& {
+            return d[i*(m + 1) + j];
+        };
+        auto same = [&](std::size_t i, std::size_t j){
+            return a[piece.aFirst + i - 1] == b[piece.bFirst + j - 1];
+        };
+        for (std::size_t j = 0; j <= m; ++j) at(0, j) = j*costs.ins;
+        for (std::size_t i = 1; i <= n; ++i) {
+            at(i, 0) = i*costs.del;
+            for (std::size_t j = 1; j <= m; ++j) {
+                at(i, j) = std::min({
+                    at(i-1, j-1) + (same(i, j) ? 0 : costs.sub),
+                    at(i, j-1) + costs.ins,
+                    at(i-1, j) + costs.del});
+            }
+        }
+
+        std::size_t first = edits.size();
+        std::size_t i = n;
+        std::size_t j = m;
+        while (i > 0 || j > 0) {
+            if (i > 0 && j > 0) {
+                bool match = same(i, j);
+                if (at(i, j) == at(i-1, j-1) + (match ? 0 : costs.sub)) {
+                    i -= 1;
+                    j -= 1;
+                    edits.push_back({match ? EditType::match : EditType::sub,
+                                     piece.aFirst + i, piece.bFirst + j});
+                    continue;
+                }
+            }
+            if (i > 0 && at(i, j) == at(i-1, j) + costs.del) {
+                i -= 1;
+                edits.push_back({EditType::del, piece.aFirst + i,
+                                 piece.bFirst + j});
+            } else {
+                j -= 1;
+                edits.push_back({EditType::ins, piece.aFirst + i,
+                                 piece.bFirst + j});
+            }
+        }
+        std::reverse(edits.begin() + first, edits.end());
+    }
+
+    template<class RandomItA, class RandomItB>
+    void AlignPiece(RandomItA a, RandomItB b, const AlignmentPiece& piece,
+                    const LevenshteinCosts& costs,
+                    std::vector<LevenshteinEdit>& edits) {
+        std::size_t n = piece.aLast - piece.aFirst;
+        std::size_t m = piece.bLast - piece.bFirst;
+        if (n <= 1 || (n + 1)*(m + 1) <= alignmentDirectCells) {
+            AlignDirectly(a, b, piece, costs, edits);
+            return;
+        }
+        std::size_t middle = piece.aFirst + n/2;
+        std::size_t split = SplitPoint(a, b, piece, middle, costs, nullptr);
+        AlignPiece(a, b, {piece.aFirst, middle, piece.bFirst, split}, costs,
+                   edits);
+        AlignPiece(a, b, {middle, piece.aLast, split, piece.bLast}, costs,
+                   edits);
+    }
+
+    // The edit script for a and b, splitting a (so the rows are as long as
+    // b).
+    template<class RandomItA, class RandomItB>
+    std::vector<LevenshteinEdit> EditScript(
+            RandomItA aBegin, RandomItA aEnd, RandomItB bBegin, RandomItB bEnd,
+            const LevenshteinCosts& costs, ThreadPool* pool) {
+        std::vector<LevenshteinEdit> edits;
+        std::vector<AlignmentPiece> pieces{
+            {0, static_cast<std::size_t>(aEnd - aBegin),
+             0, static_cast<std::size_t>(bEnd - bBegin)}};
+        if (pool == nullptr || pool->ThreadCount() == 0) {
+            AlignPiece(aBegin, bBegin, pieces[0], costs, edits);
+            return edits;
+        }
+
+        // Split level by level from this thread (so no task ever waits for
+        // another), until there are enough pieces to keep the pool busy.
+        const std::size_t enough = 4*pool->ThreadCount();
+        while (pieces.size() < enough) {
+            std::vector<AlignmentPiece> next;
+            bool split = false;
+            for (const auto& piece : pieces) {
+                std::size_t n = piece.aLast - piece.aFirst;
+                std::size_t m = piece.bLast - piece.bFirst;
+                if (n <= 1 || (n + 1)*(m + 1) <= alignmentDirectCells) {
+                    next.push_back(piece);
+                    continue;
+                }
+                std::size_t middle = piece.aFirst + n/2;
+                std::size_t j = SplitPoint(aBegin, bBegin, piece, middle, costs,
+                                           pool);
+                next.push_back({piece.aFirst, middle, piece.bFirst, j});
+                next.push_back({middle, piece.aLast, j, piece.bLast});
+                split = true;
+            }
+            pieces.swap(next);
+            if (!split) break;
+        }
+
+        std::vector<std::future<std::vector<LevenshteinEdit>>> parts;
+        for (const auto& piece : pieces) {
+            parts.push_back(pool->AddTask([=, &costs](){
+                std::vector<LevenshteinEdit> pieceEdits;
+                AlignPiece(aBegin, bBegin, piece, costs, pieceEdits);
+                return pieceEdits;
+            }));
+        }
+        // the tasks refer to costs, so wait for all of them before anything
+        // can throw
+        for (auto& part : parts) part.wait();
+        for (auto& part : parts) {
+            auto pieceEdits = part.get();
+            edits.insert(edits.end(), pieceEdits.begin(), pieceEdits.end());
+        }
+        return edits;
+    }
+} // namespace Detail
+
+template<class RandomItA, class RandomItB>
+std::vector<LevenshteinEdit> levenshtein_edit_script(
+        RandomItA aBegin, RandomItA aEnd, RandomItB bBegin, RandomItB bEnd,
+        const LevenshteinCosts& costs = {}, ThreadPool* pool = nullptr) {
+    using Random = std::random_access_iterator_tag;
+    static_assert(std::is_base_of<Random, typename
+                      std::iterator_traits<RandomItA>::iterator_category>::value
+                  && std::is_base_of<Random, typename
+                      std::iterator_traits<RandomItB>::iterator_category>::value,
+                  "levenshtein_edit_script needs random-access iterators");
+
+    if (aEnd - aBegin >= bEnd - bBegin) {
+        return Detail::EditScript(aBegin, aEnd, bBegin, bEnd, costs, pool);
+    }
+    // Turning b into a with insertions and deletions swapped is the same
+    // problem with the rows along a, the shorter side; its script is ours
+    // with the roles of a and b swapped back.
+    LevenshteinCosts swapped = costs;
+    std::swap(swapped.ins, swapped.del);
+    auto edits = Detail::EditScript(bBegin, bEnd, aBegin, aEnd, swapped, pool);
+    for (auto& edit : edits) {
+        std::swap(edit.aIndex, edit.bIndex);
+        if (edit.type == EditType::ins) {
+            edit.type = EditType::del;
+        } else if (edit.type == EditType::del) {
+            edit.type = EditType::ins;
+        }
+    }
+    return edits;
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::vector<LevenshteinEdit> levenshtein_edit_script(
+        const ContainerA& a, const ContainerB& b,
+        const LevenshteinCosts& costs = {}, ThreadPool* pool = nullptr) {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return levenshtein_edit_script(aBegin, aEnd, bBegin, bEnd, costs, pool);
+}
+
+} // namespace LCH
+
+#endif // LCH_LEVENSHTEIN_ALIGNMENT_HPP
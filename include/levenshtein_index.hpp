@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+// levenshtein_index.hpp: a BK-tree index over a fixed set of terms, for
+// finding the ones within some Levenshtein distance of a query without
+// computing the distance to most of them.
+//
+// std::vector<std::string> vocabulary = ...;
+// LCH::LevenshteinIndex<std::string> index(vocabulary);
+// for (auto match : index.Query("recieve", 2)) {
+//     std::cout << index[match.index] << " at " << match.distance << '\n';
+// }
+//
+// Query returns LevenshteinMatches (see levenshtein_search.hpp) for all the
+// terms within maxDist of the query, nearest first, where the index is the
+// term's position in the sequence the index was built from. The query can be
+// anything levenshtein_distance can compare with a Term.
+//
+// A BK-tree hangs each term below the first term on its path from the root at
+// a distance not yet used by that term's children, labelling the edge with the
+// distance. By the triangle inequality, the only children of a term at
+// distance d from the query which can lead to terms within maxDist are the
+// ones with labels from d - maxDist to d + maxDist, so the rest of the tree is
+// skipped. The distance used is levenshtein_distance with the costs given at
+// construction; this is only a metric if insertions and deletions cost the
+// same, so other costs are rejected with std::invalid_argument.
+//
+// The index can't be changed after it's built, and Query is const and only
+// reads it, so any number of threads can query the same index at once.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_LEVENSHTEIN_INDEX_HPP
+#define LCH_LEVENSHTEIN_INDEX_HPP
+
+#include "levenshtein.hpp"
+#include "levenshtein_search.hpp"
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <limits>
+#include <stdexcept>
+#include <algorithm> // lower_bound, sort
+
+namespace LCH {
+
+template<class Term = std::string>
+class LevenshteinIndex {
+  public:
+    template<class InputIt>
+    LevenshteinIndex(InputIt begin, InputIt end,
+                     const LevenshteinCosts& costs = {}):
+            costs(costs) {
+        Build(std::vector<Term>(begin, end));
+    }
+
+    explicit LevenshteinIndex(std::vector<Term> terms,
+                              const LevenshteinCosts& costs = {}):
+            costs(costs) {
+        Build(std::move(terms));
+    }
+
+    template<class QueryTerm>
+    std::vector<LevenshteinMatch> Query(const QueryTerm& query,
+                                        std::size_t maxDist) const {
+        std::vector<LevenshteinMatch> matches;
+        if (nodes.empty()) return matches;
+
+        auto [qBegin, qEnd] = get_iterators(query);
+        Detail::LevenshteinScanner<decltype(qBegin)> scanner(qBegin, qEnd,
+                                                             costs);
+        std::vector<std::size_t> pending{0};
+        while (!pending.empty()) {
+            std::size_t node = pending.back();
+            pending.pop_back();
+
+            // Only the distance up to maxDist past the farthest child matters;
+            // anything beyond that rules out this term and all its children.
+            std::size_t first = childStart[node];
+            std::size_t last = childStart[node + 1];
+            std::size_t farthest = first < last ? childDistance[last - 1] : 0;
+            std::size_t bound = SaturatingAdd(maxDist, farthest);
+            std::size_t distance = scanner.Distance(nodes[node], bound);
+            if (distance <= maxDist) {
+                matches.push_back({original[node], distance});
+            }
+            if (distance > bound) continue;
+
+            std::size_t low = distance > maxDist ? distance - maxDist : 0;
+            std::size_t high = SaturatingAdd(distance, maxDist);
+            std::size_t child = std::lower_bound(
+                    childDistance.begin() + first, childDistance.begin() + last,
+                    low) - childDistance.begin();
+            for (; child < last && childDistance[child] <= high; ++child) {
+                pending.push_back(child + 1);
+            }
+        }
+
+        std::sort(matches.begin(), matches.end(), Detail::CloserMatch);
+        return matches;
+    }
+
+    std::size_t Size() const noexcept { return nodes.size(); }
+    const Term& operator[](std::size_t i) const noexcept {
+        return nodes[position[i]];
+    }
+    const LevenshteinCosts& Costs() const noexcept { return costs; }
+
+  private:
+    LevenshteinCosts costs;
+
+    // The terms, as nodes of the tree in breadth-first order, so that the
+    // children of a node are consecutive nodes and searching a subtree tends
+    // to stay in the same part of memory. The children of node i are nodes
+    // childStart[i] + 1 up to (not including) childStart[i+1] + 1, sorted by
+    // their edge labels, which are in childDistance. original and position
+    // translate between node numbers and the order terms were given in.
+    std::vector<Term> nodes;
+    std::vector<std::size_t> original;
+    std::vector<std::size_t> position;
+    std::vector<std::size_t> childStart;
+    std::vector<std::size_t> childDistance;
+
+    static std::size_t SaturatingAdd(std::size_t x, std::size_t y) noexcept {
+        // leave room for the + 1 levenshtein_distance_bounded may add
+        constexpr std::size_t max = std::numeric_limits<std::size_t>::max() - 1;
+        return x > max - y ? max : x + y;
+    }
+
+    void Build(std::vector<Term> terms) {
+        if (costs.ins != costs.del) {
+            throw std::invalid_argument("LCH::LevenshteinIndex: insertion and "
+                                        "deletion costs must be equal");
+        }
+
+        // (label, term) pairs, sorted, for each term
+        std::vector<std::vector<std::pair<std::size_t, std::size_t>>>
+                children(terms.size());
+        for (std::size_t i = 1; i < terms.size(); ++i) {
+            std::size_t parent = 0;
+            while (true) {
+                std::size_t distance = levenshtein_distance(terms[parent],
+                                                            terms[i], costs);
+                auto& siblings = children[parent];
+                auto slot = std::lower_bound(
+                        siblings.begin(), siblings.end(),
+                        std::make_pair(distance, std::size_t(0)));
+                if (slot != siblings.end() && slot->first == distance) {
+                    parent = slot->second;
+                } else {
+                    siblings.emplace(slot, distance, i);
+                    break;
+                }
+            }
+        }
+        if (terms.empty()) return;
+
+        original.reserve(terms.size());
+        childStart.reserve(terms.size() + 1);
+        childDistance.reserve(terms.size() - 1);
+        original.push_back(0);
+        for (std::size_t node = 0; node < original.size(); ++node) {
+            childStart.push_back(childDistance.size());
+            for (auto [distance, term] : children[original[node]]) {
+                childDistance.push_back(distance);
+                original.push_back(term);
+            }
+            children[original[node]] = {};
+        }
+        childStart.push_back(childDistance.size());
+
+        nodes.reserve(terms.size());
+        position.resize(terms.size());
+        for (std::size_t node = 0; node < original.size(); ++node) {
+            nodes.push_back(std::move(terms[original[node]]));
+            position[original[node]] = node;
+        }
+    }
+};
+
+} // namespace LCH
+
+#endif // LCH_LEVENSHTEIN_INDEX_HPP
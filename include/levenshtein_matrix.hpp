@@ -0,0 +1,181 @@
+///////////////////////////////////////////////////////////////////////////////
+// levenshtein_matrix.hpp: all-pairs Levenshtein distances over a collection of
+// strings (or other sequences), e.g. as the input to clustering.
+//
+// std::vector<std::string> strings = ...;
+// LCH::Matrix<std::uint16_t> distances
+//         = LCH::levenshtein_distance_matrix(strings, costs, &pool);
+// std::vector<std::uint16_t> condensed
+//         = LCH::levenshtein_condensed_distances(strings, costs, &pool);
+//
+// levenshtein_distance_matrix gives the full n x n matrix, with the distance
+// from strings[i] to strings[j] at (i, j). levenshtein_condensed_distances
+// gives only the pairs i < j, in order (i.e. row by row of the upper
+// triangle, like SciPy's pdist): the pair (i, j) is at index
+// i*n - i*(i + 1)/2 + j - i - 1, which condensed_index calculates. The element
+// type (uint16_t unless given as the first template argument) can be any
+// unsigned integer type; distances too big for it are stored as its maximum.
+// The elements of strings can be anything levenshtein_distance accepts, and
+// strings must be a random-access container (or array).
+//
+// When insertions and deletions cost the same, the distance is symmetric, so
+// only the upper triangle is computed and the full matrix gets a copy of it
+// below the diagonal. Otherwise every pair is computed both ways, and the
+// condensed form (which can't represent that) throws std::invalid_argument.
+//
+// The pairs are worked through in tiles of a few dozen rows by a few hundred
+// columns, so the column strings of a tile stay in cache while each of its
+// rows is compared with them; each row string is prepared once per tile (see
+// levenshtein_search.hpp) and then run against the whole tile. Since the
+// distances are bounded by the maximum of the element type, comparisons give
+// up as soon as they go past it. With a ThreadPool, each of its threads takes
+// tiles until none are left; this waits for them, so don't call it from a task
+// on the same pool.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_LEVENSHTEIN_MATRIX_HPP
+#define LCH_LEVENSHTEIN_MATRIX_HPP
+
+#include "levenshtein.hpp"
+#include "levenshtein_search.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <atomic>
+#include <future>
+#include <limits>
+#include <cstdint>
+#include <iterator> // size
+#include <algorithm> // min, max
+#include <stdexcept>
+#include <type_traits>
+
+namespace LCH {
+
+// Where the pair (i, j), i < j, of n things is in a condensed distance vector.
+inline std::size_t condensed_index(std::size_t n, std::size_t i,
+                                   std::size_t j) noexcept {
+    return i*n - i*(i + 1)/2 + j - i - 1;
+}
+
+namespace Detail {
+    constexpr std::size_t pairTileRows = 32;
+    constexpr std::size_t pairTileCols = 256;
+
+    // Calls store(i, j, distance) for every pair of strings with i != j, or
+    // only i < j if symmetric, with distances capped at max.
+    template<class Strings, class Store>
+    void AllPairDistances(const Strings& strings, const LevenshteinCosts& costs,
+                          bool symmetric, std::size_t max, ThreadPool* pool,
+                          const Store& store) {
+        const std::size_t n = std::size(strings);
+        const std::size_t rowTiles = (n + pairTileRows - 1)/pairTileRows;
+        const std::size_t colTiles = (n + pairTileCols - 1)/pairTileCols;
+
+        auto doTile = [&](std::size_t tile){
+            std::size_t rowFirst = tile/colTiles*pairTileRows;
+            std::size_t rowLast = std::min(n, rowFirst + pairTileRows);
+            std::size_t colFirst = tile%colTiles*pairTileCols;
+            std::size_t colLast = std::min(n, colFirst + pairTileCols);
+            // nothing above the diagonal
+            if (symmetric && colLast <= rowFirst + 1) return;
+
+            for (std::size_t i = rowFirst; i < rowLast; ++i) {
+                std::size_t j = symmetric ? std::max(colFirst, i + 1)
+                                          : colFirst;
+                if (j >= colLast) continue;
+                auto [qBegin, qEnd] = get_iterators(strings[i]);
+                LevenshteinScanner<decltype(qBegin)> scanner(qBegin, qEnd,
+                                                             costs);
+                for (; j < colLast; ++j) {
+                    if (j == i) continue;
+                    store(i, j, std::min(scanner.Distance(strings[j], max),
+                                         max));
+                }
+            }
+        };
+
+        const std::size_t tiles = rowTiles*colTiles;
+        if (pool == nullptr || pool->ThreadCount() == 0) {
+            for (std::size_t tile = 0; tile < tiles; ++tile) doTile(tile);
+            return;
+        }
+
+        // Tiles near the diagonal are cheaper than the rest, so rather than
+        // splitting them up in advance, each thread takes the next one left.
+        std::atomic<std::size_t> next{0};
+        std::vector<std::future<void>> workers;
+        for (std::size_t t = 0; t < pool->ThreadCount(); ++t) {
+            workers.push_back(pool->AddTask([&](){
+                for (std::size_t tile = next++; tile < tiles; tile = next++) {
+                    doTile(tile);
+                }
+            }));
+        }
+        // The tasks refer to our locals, so they must all finish before an
+        // exception from any of them is let out.
+        for (auto& worker : workers) worker.wait();
+        for (auto& worker : workers) worker.get();
+    }
+} // namespace Detail
+
+template<class Distance = std::uint16_t, class Strings>
+Matrix<Distance> levenshtein_distance_matrix(
+        const Strings& strings, const LevenshteinCosts& costs = {},
+        ThreadPool* pool = nullptr) {
+    static_assert(std::is_integral_v<Distance> && std::is_unsigned_v<Distance>,
+                  "distances must be stored as an unsigned integer type");
+    const std::size_t n = std::size(strings);
+    Matrix<Distance> distances(n, n);
+    const bool symmetric = costs.ins == costs.del;
+    Detail::AllPairDistances(strings, costs, symmetric,
+            std::numeric_limits<Distance>::max(), pool,
+            [&](std::size_t i, std::size_t j, std::size_t distance){
+                distances(i, j) = static_cast<Distance>(distance);
+                if (symmetric) distances(j, i) = distances(i, j);
+            });
+    return distances;
+}
+
+template<class Distance = std::uint16_t, class Strings>
+std::vector<Distance> levenshtein_condensed_distances(
+        const Strings& strings, const LevenshteinCosts& costs = {},
+        ThreadPool* pool = nullptr) {
+    static_assert(std::is_integral_v<Distance> && std::is_unsigned_v<Distance>,
+                  "distances must be stored as an unsigned integer type");
+    if (costs.ins != costs.del) {
+        throw std::invalid_argument("LCH::levenshtein_condensed_distances: "
+                                    "insertion and deletion costs must be "
+                                    "equal");
+    }
+    const std::size_t n = std::size(strings);
+    std::vector<Distance> distances(n < 2 ? 0 : n*(n - 1)/2);
+    Detail::AllPairDistances(strings, costs, true,
+            std::numeric_limits<Distance>::max(), pool,
+            [&](std::size_t i, std::size_t j, std::size_t distance){
+                distances[condensed_index(n, i, j)]
+                    = static_cast<Distance>(distance);
+            });
+    return distances;
+}
+
+} // namespace LCH
+
+#endif // LCH_LEVENSHTEIN_MATRIX_HPP
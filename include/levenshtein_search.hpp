@@ -0,0 +1,238 @@
+///////////////////////////////////////////////////////////////////////////////
+// levenshtein_search.hpp: one-to-many Levenshtein distance, for finding the
+// entries of a dictionary that are closest to a query.
+//
+// std::vector<std::string> dictionary = ...;
+// auto close = LCH::levenshtein_search(query, dictionary, maxDist, costs);
+// auto best = LCH::levenshtein_nearest(query, dictionary, k, costs);
+//
+// levenshtein_search finds every candidate within maxDist of the query, in the
+// order they appear in candidates; levenshtein_nearest finds the k closest,
+// nearest first, with ties going to the earlier candidate. Each result is a
+// LevenshteinMatch holding the candidate's index and its distance. The query
+// is the "a" side (see levenshtein.hpp), so e.g. insertions add symbols to the
+// query; it can be anything levenshtein_distance accepts, as can the elements
+// of candidates, which must be a random-access container (or array).
+//
+// The point of these over calling levenshtein_distance in a loop is that the
+// query is only prepared once: with equal costs and integral symbols, the bit
+// masks used by Myers' algorithm are built up front and each candidate is run
+// against them, abandoning it as soon as it can't come within the bound. For
+// levenshtein_nearest, the bound is the k-th best distance found so far, so it
+// tightens as the search goes on. Other inputs go through
+// levenshtein_distance_bounded.
+//
+// Pass a ThreadPool to have the candidates split into chunks which are
+// searched in parallel; the results are the same either way. This function
+// waits for its chunks, so don't call it from inside a task on the same pool.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_LEVENSHTEIN_SEARCH_HPP
+#define LCH_LEVENSHTEIN_SEARCH_HPP
+
+#include "levenshtein.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <future>
+#include <optional>
+#include <iterator> // size
+#include <algorithm> // heap functions, sort
+
+namespace LCH {
+
+struct LevenshteinMatch {
+    std::size_t index;
+    std::size_t distance;
+};
+
+namespace Detail {
+    // Nearest first, then earliest first.
+    inline bool CloserMatch(const LevenshteinMatch& x,
+                            const LevenshteinMatch& y) noexcept {
+        return x.distance < y.distance
+               || (x.distance == y.distance && x.index < y.index);
+    }
+
+    // The query side of a one-to-many search, prepared once and then shared
+    // (read-only) by every chunk of the search.
+    template<class QueryIt>
+    class LevenshteinScanner {
+      public:
+        LevenshteinScanner(QueryIt begin, QueryIt end,
+                           const LevenshteinCosts& costs):
+                begin(begin), end(end), size(std::distance(begin, end)),
+                costs(costs) {
+            if constexpr (integral_symbols<QueryIt, QueryIt>) {
+                if (costs.sub == costs.ins && costs.ins == costs.del
+                    && costs.sub > 0) {
+                    masks.emplace(begin, end, PatternStorage::owned);
+                }
+            }
+        }
+
+        // The distance from the query to candidate if it's at most maxDist,
+        // or else maxDist + 1.
+        template<class Candidate>
+        std::size_t Distance(const Candidate& candidate,
+                             std::size_t maxDist) const {
+            auto [cBegin, cEnd] = get_iterators(candidate);
+            if constexpr (integral_symbols<QueryIt, decltype(cBegin)>) {
+                if (masks) {
+                    std::size_t maxEdits = maxDist/costs.sub;
+                    std::size_t cSize = std::distance(cBegin, cEnd);
+                    std::size_t gap = cSize > size ? cSize - size 
+                                                   : size - cSize;
+                    if (gap > maxEdits) return maxDist + 1;
+
+                    std::size_t edits = MyersDistance(*masks, cBegin, cEnd,
+                                                      maxEdits);
+                    return edits > maxEdits ? maxDist + 1 : edits*costs.sub;
+                }
+            }
+            return levenshtein_distance_bounded(begin, end, cBegin, cEnd,
+                                                maxDist, costs);
+        }
+
+      private:
+        using Symbol = symbol_t<QueryIt>;
+
+        QueryIt begin;
+        QueryIt end;
+        std::size_t size;
+        LevenshteinCosts costs;
+        std::optional<PatternMasks<Symbol>> masks;
+    };
+
+    template<class Scanner, class Candidates>
+    std::vector<LevenshteinMatch> SearchWithin(
+            const Scanner& scanner, const Candidates& candidates,
+            std::size_t first, std::size_t last, std::size_t maxDist) {
+        std::vector<LevenshteinMatch> matches;
+        for (std::size_t i = first; i < last; ++i) {
+            std::size_t distance = scanner.Distance(candidates[i], maxDist);
+            if (distance <= maxDist) matches.push_back({i, distance});
+        }
+        return matches;
+    }
+
+    // Keeps the k best matches so far in a heap with the worst on top, so
+    // that later candidates only need to beat it.
+    template<class Scanner, class Candidates>
+    std::vector<LevenshteinMatch> SearchNearest(
+            const Scanner& scanner, const Candidates& candidates,
+            std::size_t first, std::size_t last, std::size_t k) {
+        std::vector<LevenshteinMatch> best;
+        if (k == 0) return best;
+        best.reserve(k);
+
+        constexpr std::size_t unbounded =
+            std::numeric_limits<std::size_t>::max() - 1;
+        for (std::size_t i = first; i < last; ++i) {
+            if (best.size() < k) {
+                best.push_back({i, scanner.Distance(candidates[i], unbounded)});
+                std::push_heap(best.begin(), best.end(), CloserMatch);
+                continue;
+            }
+
+            std::size_t worst = best.front().distance;
+            if (worst == 0) break;
+            std::size_t distance = scanner.Distance(candidates[i], worst - 1);
+            if (distance < worst) {
+                std::pop_heap(best.begin(), best.end(), CloserMatch);
+                best.back() = {i, distance};
+                std::push_heap(best.begin(), best.end(), CloserMatch);
+            }
+        }
+
+        std::sort_heap(best.begin(), best.end(), CloserMatch);
+        return best;
+    }
+
+    // Chunks smaller than this aren't worth a task.
+    constexpr std::size_t searchMinChunkSize = 256;
+
+    // Runs search(first, last) over [0, count), either directly or in chunks
+    // on pool, and concatenates the results in order.
+    template<class Search>
+    std::vector<LevenshteinMatch> SearchChunks(std::size_t count,
+                                               ThreadPool* pool,
+                                               const Search& search) {
+        if (pool == nullptr || pool->ThreadCount() == 0
+            || count < 2*searchMinChunkSize) {
+            return search(0, count);
+        }
+
+        std::size_t chunks = std::min(4*pool->ThreadCount(),
+                                      count/searchMinChunkSize);
+        std::vector<std::future<std::vector<LevenshteinMatch>>> parts;
+        for (std::size_t c = 0; c < chunks; ++c) {
+            std::size_t first = count*c/chunks;
+            std::size_t last = count*(c + 1)/chunks;
+            parts.push_back(pool->AddTask([&search, first, last](){
+                return search(first, last);
+            }));
+        }
+        // The tasks refer to our caller's locals, so they must all finish
+        // before an exception from any of them is let out.
+        for (auto& part : parts) part.wait();
+
+        std::vector<LevenshteinMatch> matches;
+        for (auto& part : parts) {
+            auto partMatches = part.get();
+            matches.insert(matches.end(), partMatches.begin(),
+                           partMatches.end());
+        }
+        return matches;
+    }
+} // namespace Detail
+
+template<class Query, class Candidates>
+std::vector<LevenshteinMatch> levenshtein_search(
+        const Query& query, const Candidates& candidates, std::size_t maxDist,
+        const LevenshteinCosts& costs = {}, ThreadPool* pool = nullptr) {
+    auto [qBegin, qEnd] = get_iterators(query);
+    Detail::LevenshteinScanner<decltype(qBegin)> scanner(qBegin, qEnd, costs);
+    return Detail::SearchChunks(std::size(candidates), pool,
+            [&](std::size_t first, std::size_t last){
+                return Detail::SearchWithin(scanner, candidates, first, last,
+                                            maxDist);
+            });
+}
+
+template<class Query, class Candidates>
+std::vector<LevenshteinMatch> levenshtein_nearest(
+        const Query& query, const Candidates& candidates, std::size_t k,
+        const LevenshteinCosts& costs = {}, ThreadPool* pool = nullptr) {
+    auto [qBegin, qEnd] = get_iterators(query);
+    Detail::LevenshteinScanner<decltype(qBegin)> scanner(qBegin, qEnd, costs);
+    auto matches = Detail::SearchChunks(std::size(candidates), pool,
+            [&](std::size_t first, std::size_t last){
+                return Detail::SearchNearest(scanner, candidates, first, last,
+                                             k);
+            });
+    // Each chunk found its own k best, in order.
+    std::sort(matches.begin(), matches.end(), Detail::CloserMatch);
+    if (matches.size() > k) matches.resize(k);
+    return matches;
+}
+
+} // namespace LCH
+
+#endif // LCH_LEVENSHTEIN_SEARCH_HPP
@@ -0,0 +1,332 @@
+///////////////////////////////////////////////////////////////////////////////
+// levenshtein_similarity.hpp: cheap lower bounds on the Levenshtein distance,
+// for ruling pairs out before running the DP at all, and similarity scores
+// between 0 and 1 built on top of it, plus the Jaro and Jaro-Winkler
+// similarities.
+//
+// std::size_t low = LCH::levenshtein_lower_bound(a, b, costs);
+// double s = LCH::levenshtein_similarity(a, b, costs);
+// double s = LCH::levenshtein_similarity_bounded(a, b, minSimilarity, costs);
+// double s = LCH::jaro_similarity(a, b);
+// double s = LCH::jaro_winkler_similarity(a, b, prefixScale);
+// double s = LCH::jaro_winkler_similarity_bounded(a, b, minSimilarity,
+//                                                 prefixScale);
+//
+// Each of these also takes a and b as iterator pairs (aBegin, aEnd, bBegin,
+// bEnd) in place of the containers. The Jaro functions need random-access
+// iterators; the others take anything levenshtein_distance does.
+//
+// levenshtein_lower_bound is the count filter: a symbol a has more copies of
+// than b does can't all be matched, so the extra copies cost at least a
+// deletion or a substitution each, and likewise on b's side with insertions.
+// It takes one pass over each side (counting symbols into 256 buckets, which
+// is exact for single-byte symbols and still a valid bound for wider integer
+// ones; other types only get the bound from their lengths) and never exceeds
+// levenshtein_distance(a, b, costs).
+//
+// levenshtein_similarity is 1 - distance/worst, where worst is the largest
+// distance possible between sequences of those lengths (with equal costs, the
+// longer length times the cost), so it's 1 for equal sequences (including two
+// empty ones) and 0 for ones with nothing in common. The _bounded version
+// returns 0 for anything less similar than minSimilarity, and gets there as
+// cheaply as it can: by the lower bound if possible, and otherwise with
+// levenshtein_distance_bounded.
+//
+// jaro_similarity counts the symbols of each side that have an equal, not yet
+// matched symbol within half the longer length of the same position in the
+// other, and the matched symbols that are out of order. jaro_winkler_similarity
+// then adds prefixScale (at most 0.25; the default is 0.1) times the length of
+// the common prefix (up to 4) times the remaining 1 - jaro, if the Jaro
+// similarity is over 0.7 (which is Winkler's threshold, and what most other
+// implementations use). The _bounded version returns 0 for anything less
+// similar than minSimilarity, and stops as soon as the matches found so far and
+// the symbols left can't reach it.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_LEVENSHTEIN_SIMILARITY_HPP
+#define LCH_LEVENSHTEIN_SIMILARITY_HPP
+
+#include "levenshtein.hpp"
+
+#include <array>
+#include <cmath> // floor
+#include <cstdint>
+#include <iterator> // distance
+#include <algorithm> // min, max, fill
+#include <type_traits>
+
+namespace LCH {
+
+namespace Detail {
+    // The least an alignment can cost if at least unmatchedA symbols of a and
+    // unmatchedB symbols of b can't be matched with equal ones: pair up as
+    // many as it pays to as substitutions, and delete or insert the rest.
+    inline std::size_t UnmatchedCost(std::size_t unmatchedA,
+                                     std::size_t unmatchedB,
+                                     const LevenshteinCosts& costs) noexcept {
+        std::size_t paired = std::min(unmatchedA, unmatchedB);
+        return std::min(unmatchedA*costs.del + unmatchedB*costs.ins,
+                        paired*costs.sub + (unmatchedA - paired)*costs.del
+                            + (unmatchedB - paired)*costs.ins);
+    }
+
+    template<class InputItA, class InputItB>
+    std::size_t LowerBound(InputItA aBegin, InputItA aEnd,
+                           InputItB bBegin, InputItB bEnd,
+                           const LevenshteinCosts& costs) {
+        if constexpr (integral_symbols<InputItA, InputItB>) {
+            using Unsigned = std::make_unsigned_t<symbol_t<InputItA>>;
+            std::array<std::ptrdiff_t, 256> surplus{};
+            for (; aBegin != aEnd; ++aBegin) {
+                ++surplus[static_cast<Unsigned>(*aBegin) & 0xFF];
+            }
+            for (; bBegin != bEnd; ++bBegin) {
+                --surplus[static_cast<Unsigned>(*bBegin) & 0xFF];
+            }
+            std::size_t unmatchedA = 0;
+            std::size_t unmatchedB = 0;
+            for (std::ptrdiff_t count : surplus) {
+                if (count > 0) unmatchedA += count;
+                if (count < 0) unmatchedB -= count;
+            }
+            return UnmatchedCost(unmatchedA, unmatchedB, costs);
+        } else {
+            std::size_t sizeA = std::distance(aBegin, aEnd);
+            std::size_t sizeB = std::distance(bBegin, bEnd);
+            std::size_t paired = std::min(sizeA, sizeB);
+            return UnmatchedCost(sizeA - paired, sizeB - paired, costs);
+        }
+    }
+
+    template<class InputItA, class InputItB>
+    double Similarity(InputItA aBegin, InputItA aEnd,
+                      InputItB bBegin, InputItB bEnd,
+                      double minSimilarity, const LevenshteinCosts& costs) {
+        std::size_t worst = UnmatchedCost(std::distance(aBegin, aEnd),
+                                          std::distance(bBegin, bEnd), costs);
+        if (worst == 0) return 1.0;
+        auto similarity = [=](std::size_t distance){
+            return 1.0 - static_cast<double>(distance)/worst;
+        };
+        if (minSimilarity <= 0) {
+            return similarity(levenshtein_distance(aBegin, aEnd, bBegin, bEnd,
+                                                   costs));
+        }
+        if (minSimilarity > 1) return 0.0;
+
+        // The largest distance that still counts, worked out the same way the
+        // result is so that rounding can't make them disagree.
+        auto maxDist = static_cast<std::size_t>(
+                std::floor((1.0 - minSimilarity)*worst));
+        while (maxDist > 0 && similarity(maxDist) < minSimilarity) --maxDist;
+        while (maxDist < worst && similarity(maxDist + 1) >= minSimilarity) {
+            ++maxDist;
+        }
+        if (similarity(maxDist) < minSimilarity) return 0.0;
+
+        if (LowerBound(aBegin, aEnd, bBegin, bEnd, costs) > maxDist) {
+            return 0.0;
+        }
+        std::size_t distance = levenshtein_distance_bounded(
+                aBegin, aEnd, bBegin, bEnd, maxDist, costs);
+        return distance > maxDist ? 0.0 : similarity(distance);
+    }
+
+    constexpr double winklerThreshold = 0.7;
+
+    template<class RandomItA, class RandomItB>
+    double JaroWinkler(RandomItA a, std::size_t sizeA,
+                       RandomItB b, std::size_t sizeB,
+                       double prefixScale, double minSimilarity) {
+        if (sizeA == 0 && sizeB == 0) return 1.0;
+        if (sizeA == 0 || sizeB == 0) return 0.0;
+
+        std::size_t prefix = 0;
+        std::size_t maxPrefix = std::min({sizeA, sizeB, std::size_t(4)});
+        while (prefix < maxPrefix && a[prefix] == b[prefix]) ++prefix;
+
+        auto jaro = [=](std::size_t matches, std::size_t transpositions){
+            if (matches == 0) return 0.0;
+            double m = static_cast<double>(matches);
+            return (m/sizeA + m/sizeB + (m - transpositions)/m)/3;
+        };
+        auto winkler = [=](double jaroSimilarity){
+            if (jaroSimilarity <= winklerThreshold) return jaroSimilarity;
+            return jaroSimilarity + prefix*prefixScale*(1 - jaroSimilarity);
+        };
+        // Both only grow with the number of matches.
+        auto couldReach = [&](std::size_t maxMatches){
+            return winkler(jaro(maxMatches, 0)) >= minSimilarity;
+        };
+        if (!couldReach(std::min(sizeA, sizeB))) return 0.0;
+
+        std::size_t window = std::max(sizeA, sizeB)/2;
+        window = window > 0 ? window - 1 : 0;
+        auto* aMatched = Scratch<unsigned char>(ScratchSlot::a, sizeA);
+        auto* bMatched = Scratch<unsigned char>(ScratchSlot::b, sizeB);
+        std::fill(aMatched, aMatched + sizeA, 0);
+        std::fill(bMatched, bMatched + sizeB, 0);
+
+        std::size_t matches = 0;
+        for (std::size_t i = 0; i < sizeA; ++i) {
+            std::size_t first = i > window ? i - window : 0;
+            std::size_t last = std::min(sizeB, i + window + 1);
+            for (std::size_t j = first; j < last; ++j) {
+                if (!bMatched[j] && a[i] == b[j]) {
+                    aMatched[i] = bMatched[j] = 1;
+                    ++matches;
+                    break;
+                }
+            }
+            if (minSimilarity > 0
+                && !couldReach(matches + std::min(sizeA - i - 1,
+                                                  sizeB - matches))) {
+                return 0.0;
+            }
+        }
+        if (matches == 0) return 0.0;
+
+        // matched symbols in a and b that pair up out of order
+        std::size_t outOfOrder = 0;
+        for (std::size_t i = 0, j = 0; i < sizeA; ++i) {
+            if (!aMatched[i]) continue;
+            while (!bMatched[j]) ++j;
+            if (!(a[i] == b[j])) ++outOfOrder;
+            ++j;
+        }
+        double similarity = winkler(jaro(matches, outOfOrder/2));
+        return similarity >= minSimilarity ? similarity : 0.0;
+    }
+} // namespace Detail
+
+template<class InputItA, class InputItB>
+std::size_t levenshtein_lower_bound(
+        InputItA aBegin, InputItA aEnd, InputItB bBegin, InputItB bEnd,
+        const LevenshteinCosts& costs = {}) noexcept {
+    return Detail::LowerBound(aBegin, aEnd, bBegin, bEnd, costs);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+std::size_t levenshtein_lower_bound(
+        const ContainerA& a, const ContainerB& b,
+        const LevenshteinCosts& costs = {}) noexcept {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return Detail::LowerBound(aBegin, aEnd, bBegin, bEnd, costs);
+}
+
+template<class InputItA, class InputItB>
+double levenshtein_similarity(
+        InputItA aBegin, InputItA aEnd, InputItB bBegin, InputItB bEnd,
+        const LevenshteinCosts& costs = {}) noexcept {
+    return Detail::Similarity(aBegin, aEnd, bBegin, bEnd, 0.0, costs);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+double levenshtein_similarity(
+        const ContainerA& a, const ContainerB& b,
+        const LevenshteinCosts& costs = {}) noexcept {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return Detail::Similarity(aBegin, aEnd, bBegin, bEnd, 0.0, costs);
+}
+
+template<class InputItA, class InputItB>
+double levenshtein_similarity_bounded(
+        InputItA aBegin, InputItA aEnd, InputItB bBegin, InputItB bEnd,
+        double minSimilarity, const LevenshteinCosts& costs = {}) noexcept {
+    return Detail::Similarity(aBegin, aEnd, bBegin, bEnd, minSimilarity,
+                              costs);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+double levenshtein_similarity_bounded(
+        const ContainerA& a, const ContainerB& b, double minSimilarity,
+        const LevenshteinCosts& costs = {}) noexcept {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return Detail::Similarity(aBegin, aEnd, bBegin, bEnd, minSimilarity,
+                              costs);
+}
+
+template<class RandomItA, class RandomItB>
+double jaro_similarity(RandomItA aBegin, RandomItA aEnd,
+                       RandomItB bBegin, RandomItB bEnd) noexcept {
+    return Detail::JaroWinkler(aBegin, aEnd - aBegin, bBegin, bEnd - bBegin,
+                               0.0, 0.0);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+double jaro_similarity(const ContainerA& a, const ContainerB& b) noexcept {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return jaro_similarity(aBegin, aEnd, bBegin, bEnd);
+}
+
+template<class RandomItA, class RandomItB>
+double jaro_winkler_similarity(RandomItA aBegin, RandomItA aEnd,
+                               RandomItB bBegin, RandomItB bEnd,
+                               double prefixScale = 0.1) noexcept {
+    return Detail::JaroWinkler(aBegin, aEnd - aBegin, bBegin, bEnd - bBegin,
+                               prefixScale, 0.0);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+double jaro_winkler_similarity(const ContainerA& a, const ContainerB& b,
+                               double prefixScale = 0.1) noexcept {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return jaro_winkler_similarity(aBegin, aEnd, bBegin, bEnd, prefixScale);
+}
+
+template<class RandomItA, class RandomItB>
+double jaro_winkler_similarity_bounded(RandomItA aBegin, RandomItA aEnd,
+                                       RandomItB bBegin, RandomItB bEnd,
+                                       double minSimilarity,
+                                       double prefixScale = 0.1) noexcept {
+    return Detail::JaroWinkler(aBegin, aEnd - aBegin, bBegin, bEnd - bBegin,
+                               prefixScale, minSimilarity);
+}
+
+template<class ContainerA, class ContainerB,
+         std::enable_if_t<is_iterable<ContainerA>::value, bool> = true,
+         std::enable_if_t<is_iterable<ContainerB>::value, bool> = true>
+double jaro_winkler_similarity_bounded(const ContainerA& a,
+                                       const ContainerB& b,
+                                       double minSimilarity,
+                                       double prefixScale = 0.1) noexcept {
+    auto [aBegin, aEnd] = get_iterators(a);
+    auto [bBegin, bEnd] = get_iterators(b);
+    return jaro_winkler_similarity_bounded(aBegin, aEnd, bBegin, bEnd,
+                                           minSimilarity, prefixScale);
+}
+
+} // namespace LCH
+
+#endif // LCH_LEVENSHTEIN_SIMILARITY_HPP
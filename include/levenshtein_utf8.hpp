@@ -0,0 +1,210 @@
+///////////////////////////////////////////////////////////////////////////////
+// levenshtein_utf8.hpp: Levenshtein distance between UTF-8 strings, counting
+// code points rather than bytes.
+//
+// std::size_t dist = LCH::utf8_levenshtein_distance(a, b, costs);
+// std::size_t dist = LCH::utf8_levenshtein_distance_bounded(a, b, maxDist,
+//                                                           costs);
+//
+// a and b are anything that converts to std::string_view. Passing a std::string
+// to levenshtein_distance compares bytes, so e.g. changing one kana for another
+// costs 3; these compare code points, as if both sides had been converted to
+// std::u32string first, without the caller having to allocate one per call.
+// Otherwise they work exactly like levenshtein_distance and
+// levenshtein_distance_bounded (see levenshtein.hpp).
+//
+// Both sides are decoded once, into buffers kept by each thread between calls,
+// and the decoded code points go through the usual fast paths, which also keep
+// their working memory between calls, so once the buffers are big enough
+// nothing is allocated (growing them can throw std::bad_alloc, so these aren't
+// noexcept). Before decoding, any bytes the two have in common at either end
+// are skipped (backing off to the nearest code point boundary), and if what's
+// left of both is plain ASCII, the bytes are compared directly with no
+// decoding at all.
+//
+// Bytes which aren't part of a valid UTF-8 sequence (including overlong forms,
+// surrogates, and anything past U+10FFFF) are each treated as a symbol of their
+// own, different from every code point and from each other invalid byte value,
+// so malformed input still gives a sensible distance instead of an error.
+//
+// Note that these work on code points, not grapheme clusters: a base letter
+// followed by a combining accent counts as two symbols, as does an emoji with a
+// skin tone modifier, and precomposed and decomposed forms of the same text are
+// not considered equal. Normalize first if that matters.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_LEVENSHTEIN_UTF8_HPP
+#define LCH_LEVENSHTEIN_UTF8_HPP
+
+#include "levenshtein.hpp"
+
+#include <string_view>
+#include <cstdint>
+#include <cstring> // memcpy
+
+namespace LCH {
+
+namespace Detail {
+    inline bool IsContinuationByte(unsigned char byte) noexcept {
+        return (byte & 0xC0) == 0x80;
+    }
+
+    // Checks eight bytes at a time for any with the high bit set.
+    inline bool IsASCII(std::string_view text) noexcept {
+        const char* p = text.data();
+        std::size_t n = text.size();
+        std::uint64_t high = 0;
+        for (; n >= 8; p += 8, n -= 8) {
+            std::uint64_t word;
+            std::memcpy(&word, p, 8);
+            high |= word;
+        }
+        for (; n > 0; ++p, --n) high |= static_cast<unsigned char>(*p);
+        return (high & 0x8080808080808080u) == 0;
+    }
+
+    // Invalid bytes decode to this plus their value, which is past the end of
+    // the code point range.
+    constexpr std::uint32_t invalidUTF8Base = 0x110000;
+
+    // Decodes text into output, which must have room for text.size() code
+    // points, and returns the number written.
+    inline std::size_t DecodeUTF8(std::string_view text,
+                                  std::uint32_t* output) noexcept {
+        const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+        const auto* end = p + text.size();
+        std::uint32_t* out = output;
+        while (p != end) {
+            unsigned char lead = *p;
+            if (lead < 0x80) {
+                *out++ = lead;
+                ++p;
+                continue;
+            }
+
+            std::size_t length;
+            std::uint32_t codePoint;
+            std::uint32_t min;
+            if ((lead & 0xE0) == 0xC0) {
+                length = 2, codePoint = lead & 0x1F, min = 0x80;
+            } else if ((lead & 0xF0) == 0xE0) {
+                length = 3, codePoint = lead & 0x0F, min = 0x800;
+            } else if ((lead & 0xF8) == 0xF0) {
+                length = 4, codePoint = lead & 0x07, min = 0x10000;
+            } else {
+                length = 0, codePoint = 0, min = 0;
+            }
+
+            bool valid = length != 0
+                         && static_cast<std::size_t>(end - p) >= length;
+            for (std::size_t k = 1; valid && k < length; ++k) {
+                valid = IsContinuationByte(p[k]);
+                codePoint = (codePoint << 6) | (p[k] & 0x3F);
+            }
+            valid = valid && codePoint >= min && codePoint <= 0x10FFFF
+                    && (codePoint < 0xD800 || codePoint > 0xDFFF);
+            if (valid) {
+                *out++ = codePoint;
+                p += length;
+            } else {
+                *out++ = invalidUTF8Base + lead;
+                ++p;
+            }
+        }
+        return out - output;
+    }
+
+    // Drops the bytes a and b have in common at each end, as far as the
+    // nearest code point boundary (in both) that keeps the rest decoding the
+    // same way it would have as part of the whole string.
+    inline void TrimCommonUTF8(std::string_view& a,
+                               std::string_view& b) noexcept {
+        auto byte = [](std::string_view s, std::size_t i){
+            return static_cast<unsigned char>(s[i]);
+        };
+        auto boundary = [&](std::string_view s, std::size_t i){
+            return i == s.size() || !IsContinuationByte(byte(s, i));
+        };
+
+        std::size_t limit = std::min(a.size(), b.size());
+        std::size_t prefix = 0;
+        while (prefix < limit && a[prefix] == b[prefix]) ++prefix;
+        while (prefix > 0 && !(boundary(a, prefix) && boundary(b, prefix))) {
+            --prefix;
+        }
+        a.remove_prefix(prefix);
+        b.remove_prefix(prefix);
+
+        limit = std::min(a.size(), b.size());
+        std::size_t suffix = 0;
+        while (suffix < limit
+               && a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix]) {
+            ++suffix;
+        }
+        while (suffix > 0 && !(boundary(a, a.size() - suffix)
+                               && boundary(b, b.size() - suffix))) {
+            --suffix;
+        }
+        a.remove_suffix(suffix);
+        b.remove_suffix(suffix);
+    }
+
+    // Calls f with iterator pairs for a and b that give their code points:
+    // the bytes themselves if they're both ASCII, or else their decoded forms.
+    template<class Function>
+    decltype(auto) WithCodePoints(std::string_view a, std::string_view b,
+                                  Function&& f) {
+        TrimCommonUTF8(a, b);
+        if (IsASCII(a) && IsASCII(b)) {
+            return f(a.begin(), a.end(), b.begin(), b.end());
+        }
+        std::uint32_t* aPoints = Scratch<std::uint32_t>(ScratchSlot::decodedA,
+                                                        a.size());
+        std::uint32_t* bPoints = Scratch<std::uint32_t>(ScratchSlot::decodedB,
+                                                        b.size());
+        std::size_t sizeA = DecodeUTF8(a, aPoints);
+        std::size_t sizeB = DecodeUTF8(b, bPoints);
+        const std::uint32_t* aBegin = aPoints;
+        const std::uint32_t* bBegin = bPoints;
+        return f(aBegin, aBegin + sizeA, bBegin, bBegin + sizeB);
+    }
+} // namespace Detail
+
+inline std::size_t utf8_levenshtein_distance(
+        std::string_view a, std::string_view b,
+        const LevenshteinCosts& costs = {}) {
+    return Detail::WithCodePoints(a, b,
+            [&](auto aBegin, auto aEnd, auto bBegin, auto bEnd){
+                return levenshtein_distance(aBegin, aEnd, bBegin, bEnd, costs);
+            });
+}
+
+inline std::size_t utf8_levenshtein_distance_bounded(
+        std::string_view a, std::string_view b, std::size_t maxDist,
+        const LevenshteinCosts& costs = {}) {
+    return Detail::WithCodePoints(a, b,
+            [&](auto aBegin, auto aEnd, auto bBegin, auto bEnd){
+                return levenshtein_distance_bounded(aBegin, aEnd, bBegin, bEnd,
+                                                    maxDist, costs);
+            });
+}
+
+} // namespace LCH
+
+#endif // LCH_LEVENSHTEIN_UTF8_HPP
@@ -2,6 +2,99 @@
 // matrix.hpp: a general purpose matrix class with some basic access,
 // arithmetic, and IO functions. If performance is important, use a real matrix
 // library like Eigen!
+//
+// The exception is multiplication, which is common and slow enough done
+// naively that it gets a proper implementation:
+//
+// LCH::Matrix<double> c = a*b;
+// LCH::Gemm(alpha, a, b, beta, c); // c = alpha*a*b + beta*c
+//
+// Both throw std::invalid_argument if the dimensions don't fit (or if c is a
+// or b, for Gemm). They follow the usual BLAS-like scheme: b is copied in
+// blocks that fit in the L3 cache, a in blocks that fit in L2, both laid out
+// in the order a small "micro-kernel" reads them, which then keeps a 6 x 8 or
+// 6 x 16 tile of c in registers while running along the shared dimension. For
+// float and double on CPUs with AVX2 and FMA (see hardware.hpp), the
+// micro-kernel uses those; otherwise it's plain C++ that the compiler can
+// vectorize as it likes, which also works for any other arithmetic T.
+//
+// Element-wise arithmetic is lazy:
+//
+// LCH::Matrix<double> d = a*2 + b - c;
+// d += LCH::ElementwiseProduct(a, b)/4;
+// d = LCH::Apply(-d, [](double x){ return std::exp(x); });
+//
+// +, - (binary and unary), * and / by a scalar (of the matrix's value_type),
+// ElementwiseProduct, ElementwiseQuotient, and Apply don't compute anything;
+// they return small expression objects recording what to do, and the whole
+// expression is evaluated in a single loop over the elements when it's
+// assigned to (or used to construct) a Matrix, with no temporaries. Assigning
+// to an existing Matrix reuses its storage, and since each element only
+// depends on the same element of the operands, the target can also appear in
+// the expression. The dimensions of the operands must match, and those of an
+// existing Matrix being assigned to must match the expression's; otherwise
+// std::invalid_argument is thrown (by the operator, or the assignment). Note
+// that * between two matrices is still the matrix product, which evaluates
+// (any expressions given to it, and) its result right away.
+//
+// ToText and WriteToFile write a matrix as text, in the format ReadFromFile
+// reads: each row on a line of its own (ending with a newline), with the
+// elements separated by spaces. Numbers are formatted with std::to_chars, so
+// floating point numbers get the shortest text that reads back as the same
+// number, and the text is built up in a large buffer which is written out
+// whole. Given true, they also right-align the columns; every element is
+// still only formatted once, into a buffer holding the whole matrix's text
+// while the column widths are found. operator<< is much slower, but uses the
+// stream's formatting flags.
+//
+// ReadFromFile loads a matrix written as text, one row per line with the
+// elements separated by spaces or tabs (lines with nothing on them are
+// skipped). The file is memory-mapped rather than read through a stream, and
+// numbers are parsed with std::from_chars (any other T uses operator>>); with
+// a ThreadPool, the file is cut into pieces at line breaks which its threads
+// parse at the same time, straight into their places in the new matrix. It
+// throws std::runtime_error if the file can't be read, if an element can't be
+// parsed, or if the rows aren't all the same length.
+//
+// WriteBinary and ReadBinary save and load matrices of arithmetic types
+// exactly, in a simple binary format: a 64-byte header, then the elements as
+// they are in memory, row by row. The header has
+//
+// offset  size  contents
+//      0     8  "LCHMATRX"
+//      8     4  0x01020304 in the writer's byte order
+//     12     4  format version (1)
+//     16     4  element type (see MatrixElementType)
+//     20     4  element size in bytes
+//     24     8  rows
+//     32     8  cols
+//     40     8  offset of the first element (a multiple of 64)
+//     48    16  zeros
+//
+// ReadBinary converts files written on machines of the other byte order.
+// MappedMatrix<T> opens such a file without reading it: it maps the file
+// into memory, so opening it takes the same (short) time however big it is,
+// and the OS reads pages as they're used and can drop them again under memory
+// pressure. It's read-only, but otherwise works like a Matrix<T> (including
+// as an operand of the element-wise operations above). Both throw
+// std::runtime_error if the file can't be read, or holds something other
+// than a matrix of T in this machine's byte order (MappedMatrix) or either
+// byte order (ReadBinary).
+//
+// Small matrices whose size is known up front, like 3 x 3 or 4 x 4
+// transforms, can be LCH::Matrix<T, R, C> instead:
+//
+// constexpr LCH::Matrix<double, 2, 2> rotation{{0, -1,
+//                                               1,  0}};
+// LCH::Matrix<double, 2, 1> rotated = rotation*point;
+//
+// Those keep their elements in a std::array inside the object (zeroed unless
+// given), so they never allocate, and everything they do is constexpr and
+// unrolled at compile time: +, -, and * and / by a scalar are computed right
+// away (no expression templates, which wouldn't help at these sizes), and *
+// only compiles when the inner dimensions agree. A Matrix<T> can be
+// constructed from one, and the other way around with an explicit
+// conversion, which throws std::invalid_argument if the size is wrong.
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -25,21 +118,725 @@
 
 // general purpose matrix.hpp
 
-#include "LCH/file.hpp"
+#include "file.hpp"
+#include "hardware.hpp"
+#include "thread_pool.hpp"
+
+#ifdef LCH_X86_SIMD
+#include <immintrin.h>
+#endif
 
 #include <vector>
 #include <array>
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <charconv>
+#include <cstdint>
+#include <cstring> // memchr
+#include <future>
+#include <utility> // move
+#include <iterator>
+#include <algorithm> // min, fill
+#include <stdexcept>
+#include <functional> // plus, minus, etc.
+#include <type_traits>
 
 namespace LCH {
 
+namespace Detail {
+    // Block sizes for the multiplication: the micro-kernel computes an mr x nr
+    // tile of the output, from packed blocks of a (mc x kc) and b (kc x nc).
+    template<class T>
+    struct GemmBlocking {
+        static constexpr std::size_t mr = 6;
+        static constexpr std::size_t nr = sizeof(T) <= 4 ? 16 : 8;
+        static constexpr std::size_t kc = 256;
+        static constexpr std::size_t mc = 72;
+        static constexpr std::size_t nc = 2048;
+    };
+
+    // Copies rows [0, mc) and columns [0, kc) of a into panels of mr rows,
+    // each stored column by column, padding the last panel with zeros.
+    template<class T>
+    void PackA(std::size_t mc, std::size_t kc, const T* a, std::size_t lda,
+               T* packed) {
+        constexpr std::size_t mr = GemmBlocking<T>::mr;
+        for (std::size_t ir = 0; ir < mc; ir += mr) {
+            std::size_t rows = std::min(mr, mc - ir);
+            for (std::size_t p = 0; p < kc; ++p) {
+                for (std::size_t i = 0; i < rows; ++i) {
+                    packed[i] = a[(ir + i)*lda + p];
+                }
+                for (std::size_t i = rows; i < mr; ++i) packed[i] = T(0);
+                packed += mr;
+            }
+        }
+    }
+
+    // Copies rows [0, kc) and columns [0, nc) of b into panels of nr columns,
+    // each stored row by row, padding the last panel with zeros.
+    template<class T>
+    void PackB(std::size_t kc, std::size_t nc, const T* b, std::size_t ldb,
+               T* packed) {
+        constexpr std::size_t nr = GemmBlocking<T>::nr;
+        for (std::size_t jr = 0; jr < nc; jr += nr) {
+            std::size_t cols = std::min(nr, nc - jr);
+            for (std::size_t p = 0; p < kc; ++p) {
+                const T* row = b + p*ldb + jr;
+                for (std::size_t j = 0; j < cols; ++j) packed[j] = row[j];
+                for (std::size_t j = cols; j < nr; ++j) packed[j] = T(0);
+                packed += nr;
+            }
+        }
+    }
+
+    // c[0, rows) x [0, cols) += alpha*(the packed a panel times the packed b
+    // panel), accumulating the whole mr x nr tile and then adding the part
+    // that's really there.
+    template<class T>
+    void MicroKernel(std::size_t kc, const T* a, const T* b, T* c,
+                     std::size_t ldc, T alpha, std::size_t rows,
+                     std::size_t cols) {
+        constexpr std::size_t mr = GemmBlocking<T>::mr;
+        constexpr std::size_t nr = GemmBlocking<T>::nr;
+        T tile[mr][nr] = {};
+        for (std::size_t p = 0; p < kc; ++p, a += mr, b += nr) {
+            for (std::size_t i = 0; i < mr; ++i) {
+                for (std::size_t j = 0; j < nr; ++j) {
+                    tile[i][j] += a[i]*b[j];
+                }
+            }
+        }
+        for (std::size_t i = 0; i < rows; ++i) {
+            for (std::size_t j = 0; j < cols; ++j) {
+                c[i*ldc + j] += alpha*tile[i][j];
+            }
+        }
+    }
+
+#ifdef LCH_X86_SIMD
+    // The AVX2 kernels keep their 12 accumulators in registers, and write a
+    // full tile straight into c; edge tiles go through a buffer.
+    __attribute__((target("avx2,fma")))
+    inline void MicroKernelAVX2(std::size_t kc, const double* a,
+                                const double* b, double* c, std::size_t ldc,
+                                double alpha, std::size_t rows,
+                                std::size_t cols) {
+        __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+        __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+        __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+        __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+        __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+        __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+        for (std::size_t p = 0; p < kc; ++p, a += 6, b += 8) {
+            __m256d b0 = _mm256_loadu_pd(b);
+            __m256d b1 = _mm256_loadu_pd(b + 4);
+            __m256d ai = _mm256_broadcast_sd(a);
+            c00 = _mm256_fmadd_pd(ai, b0, c00);
+            c01 = _mm256_fmadd_pd(ai, b1, c01);
+            ai = _mm256_broadcast_sd(a + 1);
+            c10 = _mm256_fmadd_pd(ai, b0, c10);
+            c11 = _mm256_fmadd_pd(ai, b1, c11);
+            ai = _mm256_broadcast_sd(a + 2);
+            c20 = _mm256_fmadd_pd(ai, b0, c20);
+            c21 = _mm256_fmadd_pd(ai, b1, c21);
+            ai = _mm256_broadcast_sd(a + 3);
+            c30 = _mm256_fmadd_pd(ai, b0, c30);
+            c31 = _mm256_fmadd_pd(ai, b1, c31);
+            ai = _mm256_broadcast_sd(a + 4);
+            c40 = _mm256_fmadd_pd(ai, b0, c40);
+            c41 = _mm256_fmadd_pd(ai, b1, c41);
+            ai = _mm256_broadcast_sd(a + 5);
+            c50 = _mm256_fmadd_pd(ai, b0, c50);
+            c51 = _mm256_fmadd_pd(ai, b1, c51);
+        }
+
+        const __m256d valpha = _mm256_set1_pd(alpha);
+        const __m256d tile[6][2] = {{c00, c01}, {c10, c11}, {c20, c21},
+                                    {c30, c31}, {c40, c41}, {c50, c51}};
+        if (rows == 6 && cols == 8) {
+            for (std::size_t i = 0; i < 6; ++i, c += ldc) {
+                __m256d left = _mm256_loadu_pd(c);
+                __m256d right = _mm256_loadu_pd(c + 4);
+                _mm256_storeu_pd(c, _mm256_fmadd_pd(valpha, tile[i][0], left));
+                _mm256_storeu_pd(c + 4, _mm256_fmadd_pd(valpha, tile[i][1],
+                                                        right));
+            }
+            return;
+        }
+        double buffer[6][8];
+        for (std::size_t i = 0; i < 6; ++i) {
+            _mm256_storeu_pd(buffer[i], tile[i][0]);
+            _mm256_storeu_pd(buffer[i] + 4, tile[i][1]);
+        }
+        for (std::size_t i = 0; i < rows; ++i) {
+            for (std::size_t j = 0; j < cols; ++j) {
+                c[i*ldc + j] += alpha*buffer[i][j];
+            }
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline void MicroKernelAVX2(std::size_t kc, const float* a, const float* b,
+                                float* c, std::size_t ldc, float alpha,
+                                std::size_t rows, std::size_t cols) {
+        __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+        __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+        __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+        __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+        __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+        __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+        for (std::size_t p = 0; p < kc; ++p, a += 6, b += 16) {
+            __m256 b0 = _mm256_loadu_ps(b);
+            __m256 b1 = _mm256_loadu_ps(b + 8);
+            __m256 ai = _mm256_broadcast_ss(a);
+            c00 = _mm256_fmadd_ps(ai, b0, c00);
+            c01 = _mm256_fmadd_ps(ai, b1, c01);
+            ai = _mm256_broadcast_ss(a + 1);
+            c10 = _mm256_fmadd_ps(ai, b0, c10);
+            c11 = _mm256_fmadd_ps(ai, b1, c11);
+            ai = _mm256_broadcast_ss(a + 2);
+            c20 = _mm256_fmadd_ps(ai, b0, c20);
+            c21 = _mm256_fmadd_ps(ai, b1, c21);
+            ai = _mm256_broadcast_ss(a + 3);
+            c30 = _mm256_fmadd_ps(ai, b0, c30);
+            c31 = _mm256_fmadd_ps(ai, b1, c31);
+            ai = _mm256_broadcast_ss(a + 4);
+            c40 = _mm256_fmadd_ps(ai, b0, c40);
+            c41 = _mm256_fmadd_ps(ai, b1, c41);
+            ai = _mm256_broadcast_ss(a + 5);
+            c50 = _mm256_fmadd_ps(ai, b0, c50);
+            c51 = _mm256_fmadd_ps(ai, b1, c51);
+        }
+
+        const __m256 valpha = _mm256_set1_ps(alpha);
+        const __m256 tile[6][2] = {{c00, c01}, {c10, c11}, {c20, c21},
+                                   {c30, c31}, {c40, c41}, {c50, c51}};
+        if (rows == 6 && cols == 16) {
+            for (std::size_t i = 0; i < 6; ++i, c += ldc) {
+                __m256 left = _mm256_loadu_ps(c);
+                __m256 right = _mm256_loadu_ps(c + 8);
+                _mm256_storeu_ps(c, _mm256_fmadd_ps(valpha, tile[i][0], left));
+                _mm256_storeu_ps(c + 8, _mm256_fmadd_ps(valpha, tile[i][1],
+                                                        right));
+            }
+            return;
+        }
+        float buffer[6][16];
+        for (std::size_t i = 0; i < 6; ++i) {
+            _mm256_storeu_ps(buffer[i], tile[i][0]);
+            _mm256_storeu_ps(buffer[i] + 8, tile[i][1]);
+        }
+        for (std::size_t i = 0; i < rows; ++i) {
+            for (std::size_t j = 0; j < cols; ++j) {
+                c[i*ldc + j] += alpha*buffer[i][j];
+            }
+        }
+    }
+#endif // LCH_X86_SIMD
+
+    // c (m x n) += alpha*a (m x k)*b (k x n), all row-major with the given
+    // row strides, using kernel for each tile.
+    template<class T, class Kernel>
+    void BlockedGemm(std::size_t m, std::size_t n, std::size_t k, T alpha,
+                     const T* a, std::size_t lda, const T* b, std::size_t ldb,
+                     T* c, std::size_t ldc, Kernel kernel) {
+        using Blocking = GemmBlocking<T>;
+        constexpr std::size_t mr = Blocking::mr;
+        constexpr std::size_t nr = Blocking::nr;
+        auto roundUp = [](std::size_t x, std::size_t step){
+            return (x + step - 1)/step*step;
+        };
+        std::size_t maxKc = std::min(k, Blocking::kc);
+        std::vector<T> packedA(roundUp(std::min(m, Blocking::mc), mr)*maxKc);
+        std::vector<T> packedB(roundUp(std::min(n, Blocking::nc), nr)*maxKc);
+
+        for (std::size_t jc = 0; jc < n; jc += Blocking::nc) {
+            std::size_t nc = std::min(Blocking::nc, n - jc);
+            for (std::size_t pc = 0; pc < k; pc += Blocking::kc) {
+                std::size_t kc = std::min(Blocking::kc, k - pc);
+                PackB(kc, nc, b + pc*ldb + jc, ldb, packedB.data());
+                for (std::size_t ic = 0; ic < m; ic += Blocking::mc) {
+                    std::size_t mc = std::min(Blocking::mc, m - ic);
+                    PackA(mc, kc, a + ic*lda + pc, lda, packedA.data());
+                    for (std::size_t jr = 0; jr < nc; jr += nr) {
+                        for (std::size_t ir = 0; ir < mc; ir += mr) {
+                            kernel(kc, packedA.data() + ir*kc,
+                                   packedB.data() + jr*kc,
+                                   c + (ic + ir)*ldc + jc + jr, ldc, alpha,
+                                   std::min(mr, mc - ir),
+                                   std::min(nr, nc - jr));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template<class T>
+    void Gemm(std::size_t m, std::size_t n, std::size_t k, T alpha,
+              const T* a, const T* b, T beta, T* c) {
+        if (beta == T(0)) {
+            std::fill(c, c + m*n, T(0));
+        } else if (beta != T(1)) {
+            for (std::size_t i = 0; i < m*n; ++i) c[i] *= beta;
+        }
+        if (m == 0 || n == 0 || k == 0 || alpha == T(0)) return;
+
+#ifdef LCH_X86_SIMD
+        if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+            if (Cpu().avx2 && Cpu().fma) {
+                BlockedGemm(m, n, k, alpha, a, k, b, n, c, n,
+                        [](std::size_t kc, const T* pa, const T* pb, T* pc,
+                           std::size_t ldc, T alpha, std::size_t rows,
+                           std::size_t cols){
+                            MicroKernelAVX2(kc, pa, pb, pc, ldc, alpha, rows,
+                                            cols);
+                        });
+                return;
+            }
+        }
+#endif
+        BlockedGemm(m, n, k, alpha, a, k, b, n, c, n, MicroKernel<T>);
+    }
+
+    // One row of a Matrix, as a contiguous range of Elements (T or const T).
+    template<class Element>
+    class MatrixRow {
+      public:
+        MatrixRow(Element* first, std::size_t count) noexcept:
+                first(first), count(count) {}
+
+        Element* begin() const noexcept { return first; }
+        Element* end() const noexcept { return first + count; }
+        Element* data() const noexcept { return first; }
+        std::size_t size() const noexcept { return count; }
+        Element& operator[](std::size_t col) const noexcept {
+            return first[col];
+        }
+
+      private:
+        Element* first;
+        std::size_t count;
+    };
+
+    // A random-access iterator over the rows of a Matrix. It counts rows
+    // rather than pointing at them, so that matrices with no columns still
+    // have the right number.
+    template<class Element>
+    class MatrixRowIterator {
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = MatrixRow<Element>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = MatrixRow<Element>;
+
+        MatrixRowIterator() noexcept = default;
+        MatrixRowIterator(Element* data, std::size_t row,
+                          std::size_t cols) noexcept:
+                data(data), row(row), cols(cols) {}
+
+        reference operator*() const noexcept {
+            return {data + row*cols, cols};
+        }
+        reference operator[](difference_type n) const noexcept {
+            return *(*this + n);
+        }
+
+        MatrixRowIterator& operator++() noexcept { ++row; return *this; }
+        MatrixRowIterator& operator--() noexcept { --row; return *this; }
+        MatrixRowIterator operator++(int) noexcept {
+            MatrixRowIterator old = *this;
+            ++row;
+            return old;
+        }
+        MatrixRowIterator operator--(int) noexcept {
+            MatrixRowIterator old = *this;
+            --row;
+            return old;
+        }
+        MatrixRowIterator& operator+=(difference_type n) noexcept {
+            row += n;
+            return *this;
+        }
+        MatrixRowIterator& operator-=(difference_type n) noexcept {
+            row -= n;
+            return *this;
+        }
+        friend MatrixRowIterator operator+(MatrixRowIterator it,
+                                           difference_type n) noexcept {
+            return it += n;
+        }
+        friend MatrixRowIterator operator+(difference_type n,
+                                           MatrixRowIterator it) noexcept {
+            return it += n;
+        }
+        friend MatrixRowIterator operator-(MatrixRowIterator it,
+                                           difference_type n) noexcept {
+            return it -= n;
+        }
+        friend difference_type operator-(const MatrixRowIterator& x,
+                                         const MatrixRowIterator& y) noexcept {
+            return static_cast<difference_type>(x.row)
+                   - static_cast<difference_type>(y.row);
+        }
+
+        friend bool operator==(const MatrixRowIterator& x,
+                               const MatrixRowIterator& y) noexcept {
+            return x.row == y.row;
+        }
+        friend bool operator!=(const MatrixRowIterator& x,
+                               const MatrixRowIterator& y) noexcept {
+            return x.row != y.row;
+        }
+        friend bool operator<(const MatrixRowIterator& x,
+                              const MatrixRowIterator& y) noexcept {
+            return x.row < y.row;
+        }
+        friend bool operator>(const MatrixRowIterator& x,
+                              const MatrixRowIterator& y) noexcept {
+            return y < x;
+        }
+        friend bool operator<=(const MatrixRowIterator& x,
+                               const MatrixRowIterator& y) noexcept {
+            return !(y < x);
+        }
+        friend bool operator>=(const MatrixRowIterator& x,
+                               const MatrixRowIterator& y) noexcept {
+            return !(x < y);
+        }
+
+      private:
+        Element* data = nullptr;
+        std::size_t row = 0;
+        std::size_t cols = 0;
+    };
+
+    // Reading matrices from text files, a piece of the file at a time, and
+    // writing them a buffer at a time.
+    constexpr std::size_t textReadMinChunkSize = 1 << 20;
+    constexpr std::size_t textWriteBufferSize = 1 << 20;
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    constexpr bool floatCharsConversion = true;
+#else
+    constexpr bool floatCharsConversion = false;
+#endif
+
+    // Types read and written as numbers by std::from_chars and to_chars
+    // (operator>> and << treat the character types as single characters, and
+    // bool as 0 or 1).
+    template<class T>
+    constexpr bool chars_convertible =
+            (std::is_integral_v<T> && !std::is_same_v<T, bool>
+             && !std::is_same_v<T, char> && !std::is_same_v<T, signed char>
+             && !std::is_same_v<T, unsigned char>
+             && !std::is_same_v<T, wchar_t> && !std::is_same_v<T, char16_t>
+             && !std::is_same_v<T, char32_t>)
+            || (std::is_floating_point_v<T> && floatCharsConversion);
+
+    inline bool IsBlank(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    inline const char* LineEnd(const char* first, const char* last) noexcept {
+        const void* newline = std::memchr(first, '\n', last - first);
+        return newline ? static_cast<const char*>(newline) : last;
+    }
+
+    inline std::size_t CountTokens(const char* first, const char* last) {
+        std::size_t count = 0;
+        while (first != last) {
+            while (first != last && IsBlank(*first)) ++first;
+            if (first == last) break;
+            ++count;
+            while (first != last && !IsBlank(*first)) ++first;
+        }
+        return count;
+    }
+
+    // The number of lines in [first, last) with anything on them.
+    inline std::size_t CountTextRows(const char* first, const char* last) {
+        std::size_t rows = 0;
+        bool nonBlank = false;
+        for (; first != last; ++first) {
+            if (*first == '\n') {
+                rows += nonBlank;
+                nonBlank = false;
+            } else if (!IsBlank(*first)) {
+                nonBlank = true;
+            }
+        }
+        return rows + nonBlank;
+    }
+
+    // Parses all of [first, last) as one value; false if it isn't one.
+    template<class T>
+    bool ParseTextValue(const char* first, const char* last, T& value) {
+        if constexpr (chars_convertible<T>) {
+            // from_chars doesn't take the + that operator>> does
+            if (*first == '+' && last - first > 1 && first[1] != '-') ++first;
+            auto [end, error] = std::from_chars(first, last, value);
+            return error == std::errc() && end == last;
+        } else {
+            std::istringstream iss(std::string(first, last));
+            return iss >> value && (iss >> std::ws).eof();
+        }
+    }
+
+    // Appends value to out as text: the shortest that reads back exactly, for
+    // floating point numbers.
+    template<class T>
+    void AppendTextValue(std::string& out, const T& value) {
+        if constexpr (chars_convertible<T>) {
+            char text[64];
+            auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+            out.append(text, end);
+        } else {
+            std::ostringstream oss;
+            oss << value;
+            out += oss.str();
+        }
+    }
+
+    // Where parsing a piece of text failed, if it did.
+    struct TextParseError {
+        const char* where = nullptr;
+        bool ragged = false; // or else an element that isn't a T
+    };
+
+    // Parses the non-blank lines of [first, last), each of which must have
+    // cols elements, into out.
+    template<class T>
+    TextParseError ParseTextRows(const char* first, const char* last,
+                                 std::size_t cols, T* out) {
+        while (first != last) {
+            const char* lineStart = first;
+            const char* lineEnd = LineEnd(first, last);
+            std::size_t count = 0;
+            while (true) {
+                while (first != lineEnd && IsBlank(*first)) ++first;
+                if (first == lineEnd) break;
+                const char* tokenEnd = first;
+                while (tokenEnd != lineEnd && !IsBlank(*tokenEnd)) ++tokenEnd;
+                if (count == cols) return {lineStart, true};
+                if (!ParseTextValue(first, tokenEnd, out[count])) {
+                    return {first, false};
+                }
+                ++count;
+                first = tokenEnd;
+            }
+            if (count != 0) {
+                if (count != cols) return {lineStart, true};
+                out += cols;
+            }
+            first = lineEnd == last ? last : lineEnd + 1;
+        }
+        return {};
+    }
+
+    // Cuts [first, last) into up to pieces parts of about the same size that
+    // end at line breaks, returning the pieces + 1 boundaries.
+    inline std::vector<const char*> SplitAtLines(const char* first,
+                                                 const char* last,
+                                                 std::size_t pieces) {
+        std::vector<const char*> bounds{first};
+        const std::size_t size = last - first;
+        for (std::size_t i = 1; i < pieces; ++i) {
+            const char* target = first + size/pieces*i;
+            if (target <= bounds.back()) continue;
+            const char* lineEnd = LineEnd(target, last);
+            if (lineEnd == last) break;
+            bounds.push_back(lineEnd + 1);
+        }
+        bounds.push_back(last);
+        return bounds;
+    }
+
+    // Runs f(0), ..., f(n - 1), using the pool if there is one.
+    template<class F>
+    void ForEachPiece(std::size_t n, ThreadPool* pool, const F& f) {
+        if (pool == nullptr || pool->ThreadCount() == 0 || n <= 1) {
+            for (std::size_t i = 0; i < n; ++i) f(i);
+            return;
+        }
+        std::vector<std::future<void>> workers;
+        for (std::size_t i = 1; i < n; ++i) {
+            workers.push_back(pool->AddTask([&f, i](){ f(i); }));
+        }
+        f(0);
+        // The tasks refer to our locals, so they must all finish before an
+        // exception from any of them is let out.
+        for (auto& worker : workers) worker.wait();
+        for (auto& worker : workers) worker.get();
+    }
+} // namespace Detail
+
+enum class MatrixElementType : std::uint32_t {
+    int8 = 1, uint8, int16, uint16, int32, uint32, int64, uint64, float32,
+    float64
+};
+
+namespace Detail {
+    constexpr char binaryMatrixMagic[8] = {'L', 'C', 'H', 'M', 'A', 'T', 'R',
+                                           'X'};
+    constexpr std::uint32_t binaryMatrixByteOrder = 0x01020304;
+    constexpr std::uint32_t binaryMatrixVersion = 1;
+    constexpr std::size_t binaryMatrixHeaderSize = 64;
+
+    template<class T>
+    constexpr MatrixElementType BinaryElementType() {
+        static_assert((std::is_integral_v<T> && !std::is_same_v<T, bool>
+                       && sizeof(T) <= 8)
+                      || (std::is_floating_point_v<T>
+                          && (sizeof(T) == 4 || sizeof(T) == 8)),
+                      "LCH::Matrix: binary files hold integers or 32- or "
+                      "64-bit floating point numbers");
+        if constexpr (std::is_floating_point_v<T>) {
+            return sizeof(T) == 4 ? MatrixElementType::float32
+                                  : MatrixElementType::float64;
+        } else {
+            // the signed types come first at each size
+            std::uint32_t sizeIndex = sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1
+                                      : sizeof(T) == 4 ? 2 : 3;
+            return static_cast<MatrixElementType>(
+                    1 + 2*sizeIndex + (std::is_signed_v<T> ? 0 : 1));
+        }
+    }
+
+    template<class T>
+    T ByteSwapped(T value) noexcept {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        std::reverse(bytes, bytes + sizeof(T));
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    struct BinaryMatrixHeader {
+        std::uint32_t elementType = 0;
+        std::uint32_t elementSize = 0;
+        std::uint64_t rows = 0;
+        std::uint64_t cols = 0;
+        std::uint64_t dataOffset = binaryMatrixHeaderSize;
+        bool swapped = false; // written in the other byte order
+    };
+
+    inline std::array<char, binaryMatrixHeaderSize> EncodeBinaryMatrixHeader(
+            const BinaryMatrixHeader& header) noexcept {
+        std::array<char, binaryMatrixHeaderSize> bytes{};
+        std::memcpy(&bytes[0], binaryMatrixMagic, 8);
+        std::memcpy(&bytes[8], &binaryMatrixByteOrder, 4);
+        std::memcpy(&bytes[12], &binaryMatrixVersion, 4);
+        std::memcpy(&bytes[16], &header.elementType, 4);
+        std::memcpy(&bytes[20], &header.elementSize, 4);
+        std::memcpy(&bytes[24], &header.rows, 8);
+        std::memcpy(&bytes[32], &header.cols, 8);
+        std::memcpy(&bytes[40], &header.dataOffset, 8);
+        return bytes;
+    }
+
+    // Reads the header at the start of a file of fileSize bytes, and checks
+    // that it's a header, for a matrix of T that fits in the file.
+    template<class T>
+    BinaryMatrixHeader DecodeBinaryMatrixHeader(const char* bytes,
+                                                std::uint64_t fileSize,
+                                                const File::path& path) {
+        auto fail = [&](const std::string& problem){
+            return std::runtime_error("LCH::Matrix: " + path.string() + " "
+                                      + problem);
+        };
+        if (fileSize < binaryMatrixHeaderSize
+            || std::memcmp(bytes, binaryMatrixMagic, 8) != 0) {
+            throw fail("isn't a binary matrix file");
+        }
+        BinaryMatrixHeader header;
+        std::uint32_t byteOrder;
+        std::uint32_t version;
+        std::memcpy(&byteOrder, &bytes[8], 4);
+        std::memcpy(&version, &bytes[12], 4);
+        std::memcpy(&header.elementType, &bytes[16], 4);
+        std::memcpy(&header.elementSize, &bytes[20], 4);
+        std::memcpy(&header.rows, &bytes[24], 8);
+        std::memcpy(&header.cols, &bytes[32], 8);
+        std::memcpy(&header.dataOffset, &bytes[40], 8);
+        if (byteOrder == ByteSwapped(binaryMatrixByteOrder)) {
+            header.swapped = true;
+            version = ByteSwapped(version);
+            header.elementType = ByteSwapped(header.elementType);
+            header.elementSize = ByteSwapped(header.elementSize);
+            header.rows = ByteSwapped(header.rows);
+            header.cols = ByteSwapped(header.cols);
+            header.dataOffset = ByteSwapped(header.dataOffset);
+        } else if (byteOrder != binaryMatrixByteOrder) {
+            throw fail("has a corrupt header");
+        }
+        if (version != binaryMatrixVersion) {
+            throw fail("has unknown format version "
+                       + std::to_string(version));
+        }
+        if (header.elementType
+                != static_cast<std::uint32_t>(BinaryElementType<T>())
+            || header.elementSize != sizeof(T)) {
+            throw fail("holds elements of type "
+                       + std::to_string(header.elementType) + ", not "
+                       + std::to_string(static_cast<std::uint32_t>(
+                               BinaryElementType<T>())));
+        }
+        const std::uint64_t maxElements = fileSize/sizeof(T);
+        if (header.dataOffset < binaryMatrixHeaderSize
+            || header.dataOffset > fileSize
+            || (header.cols != 0 && header.rows > maxElements/header.cols)
+            || header.rows*header.cols*sizeof(T)
+               > fileSize - header.dataOffset) {
+            throw fail("is too short for a " + std::to_string(header.rows)
+                       + "x" + std::to_string(header.cols) + " matrix");
+        }
+        return header;
+    }
+} // namespace Detail
+
+// The dimensions of a Matrix<T> (that is, Matrix<T, dynamicExtent,
+// dynamicExtent>) are given when it's constructed; any other Matrix<T, R, C>
+// is R x C at compile time (see below).
+constexpr std::size_t dynamicExtent = static_cast<std::size_t>(-1);
+
+template<typename T, std::size_t R = dynamicExtent,
+         std::size_t C = dynamicExtent>
+class Matrix;
+
 template<typename T>
-class Matrix {
+class MappedMatrix;
+
+namespace Detail {
+    // Element-wise expressions derive from this; see below the Matrix class.
+    struct MatrixExpressionTag {};
+
+    template<class E>
+    constexpr bool matrix_node = std::is_base_of_v<MatrixExpressionTag, E>;
+
+    template<class E>
+    struct IsMatrix : std::false_type {};
+    template<class T>
+    struct IsMatrix<Matrix<T>> : std::true_type {};
+    template<class T>
+    struct IsMatrix<MappedMatrix<T>> : std::true_type {};
+
+    // Anything that can be an operand of an element-wise operation.
+    template<class E>
+    constexpr bool matrix_expression = matrix_node<E> || IsMatrix<E>::value;
+} // namespace Detail
+
+template<typename T>
+class Matrix<T, dynamicExtent, dynamicExtent> {
   public:
+    typedef T value_type;
     typedef std::size_t size_type;
     typedef std::array<size_type,2> Coords;
+    typedef Detail::MatrixRowIterator<T> iterator;
+    typedef Detail::MatrixRowIterator<const T> const_iterator;
     static constexpr Coords NullCoords {{static_cast<size_type>(-1), 
                                          static_cast<size_type>(-1)}};
 
@@ -52,6 +849,58 @@ class Matrix {
     Matrix(size_type rows, size_type cols): rows(rows), cols(cols),
                                             data(rows*cols) {}
 
+    template<class Expression,
+             std::enable_if_t<Detail::matrix_node<Expression>, bool> = true>
+    Matrix(const Expression& expression):
+            rows(expression.Rows()), cols(expression.Cols()),
+            data(rows*cols) {
+        Evaluate(expression);
+    }
+
+    Matrix(const Matrix&) = default;
+    Matrix(Matrix&&) = default;
+
+    template<std::size_t R, std::size_t C>
+    Matrix(const Matrix<T, R, C>& fixed): rows(R), cols(C),
+            data(fixed.Data(), fixed.Data() + R*C) {}
+
+    explicit Matrix(const MappedMatrix<T>& mapped):
+            rows(mapped.Rows()), cols(mapped.Cols()),
+            data(mapped.Data(), mapped.Data() + rows*cols) {}
+
+    // The dimensions are fixed, so these need the other side to match.
+    Matrix& operator=(const Matrix& other) {
+        CheckAssignable(other.rows, other.cols);
+        data = other.data;
+        return *this;
+    }
+    Matrix& operator=(Matrix&& other) {
+        CheckAssignable(other.rows, other.cols);
+        data = std::move(other.data);
+        return *this;
+    }
+
+    template<class Expression,
+             std::enable_if_t<Detail::matrix_node<Expression>, bool> = true>
+    Matrix& operator=(const Expression& expression) {
+        CheckAssignable(expression.Rows(), expression.Cols());
+        Evaluate(expression);
+        return *this;
+    }
+
+    template<class Expression, std::enable_if_t<
+                 Detail::matrix_expression<Expression>, bool> = true>
+    Matrix& operator+=(const Expression& expression) {
+        return *this = *this + expression;
+    }
+    template<class Expression, std::enable_if_t<
+                 Detail::matrix_expression<Expression>, bool> = true>
+    Matrix& operator-=(const Expression& expression) {
+        return *this = *this - expression;
+    }
+    Matrix& operator*=(const T& scalar) { return *this = *this*scalar; }
+    Matrix& operator/=(const T& scalar) { return *this = *this/scalar; }
+
     T& operator()(const size_type row, const size_type col) {
             return data.at(row*cols + col);
     }
@@ -69,61 +918,703 @@ class Matrix {
     size_type Rows() const { return rows; }
     size_type Cols() const { return cols; }
 
-    static Matrix ReadFromFile(const File::path& path) {
+    // Unchecked access, for inner loops: the elements are stored row by row
+    // in one contiguous block starting at Data(), so row i starts at Row(i)
+    // and element (i, j) is Row(i)[j]. Range-for over a Matrix gives its rows
+    // (see Detail::MatrixRow), each of which can be range-for'ed in turn.
+    T& Unchecked(size_type row, size_type col) noexcept {
+        return data[row*cols + col];
+    }
+    const T& Unchecked(size_type row, size_type col) const noexcept {
+        return data[row*cols + col];
+    }
+
+    T* Row(size_type row) noexcept { return data.data() + row*cols; }
+    const T* Row(size_type row) const noexcept {
+        return data.data() + row*cols;
+    }
+
+    T* Data() noexcept { return data.data(); }
+    const T* Data() const noexcept { return data.data(); }
+
+    iterator begin() noexcept { return {data.data(), 0, cols}; }
+    iterator end() noexcept { return {data.data(), rows, cols}; }
+    const_iterator begin() const noexcept { return {data.data(), 0, cols}; }
+    const_iterator end() const noexcept { return {data.data(), rows, cols}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    static Matrix ReadFromFile(const File::path& path,
+                               ThreadPool* pool = nullptr) {
         if (!File::exists(path)) {
             throw std::runtime_error(__FILE__ ": no file found at provided "
                                      "path " + path.native());
         }
-        std::ifstream inStream(path.native());
+        MappedFile file(path);
+        file.AdviseSequential();
+        const char* text = file.begin();
+        const char* textEnd = file.end();
+
+        // The first line with anything on it decides the number of columns.
+        size_type cols = 0;
+        for (const char* line = text; line != textEnd && cols == 0; ) {
+            const char* lineEnd = Detail::LineEnd(line, textEnd);
+            cols = Detail::CountTokens(line, lineEnd);
+            line = lineEnd == textEnd ? textEnd : lineEnd + 1;
+        }
+
+        std::size_t pieces = 1;
+        if (pool != nullptr && pool->ThreadCount() > 0) {
+            pieces = std::min(pool->ThreadCount(),
+                              file.Size()/Detail::textReadMinChunkSize + 1);
+        }
+        auto bounds = Detail::SplitAtLines(text, textEnd, pieces);
+        pieces = bounds.size() - 1;
+
+        // Counting the rows in each piece first tells each one where in the
+        // matrix its rows go, so they can be parsed straight into place.
+        std::vector<size_type> firstRows(pieces + 1, 0);
+        Detail::ForEachPiece(pieces, pool, [&](std::size_t i){
+            firstRows[i + 1] = Detail::CountTextRows(bounds[i], bounds[i + 1]);
+        });
+        for (std::size_t i = 0; i < pieces; ++i) {
+            firstRows[i + 1] += firstRows[i];
+        }
+        const size_type rows = firstRows.back();
+
+        std::vector<T> data(rows*cols);
+        std::vector<Detail::TextParseError> errors(pieces);
+        Detail::ForEachPiece(pieces, pool, [&](std::size_t i){
+            errors[i] = Detail::ParseTextRows(bounds[i], bounds[i + 1], cols,
+                                              data.data() + firstRows[i]*cols);
+        });
+        for (const auto& error : errors) {
+            if (error.where == nullptr) continue;
+            std::string line = std::to_string(
+                    std::count(text, error.where, '\n') + 1);
+            if (error.ragged) {
+                throw std::runtime_error("Matrix::ReadFromFile: matrix not "
+                        "rectangular (row lengths differ) at line " + line
+                        + " of " + path.string());
+            }
+            const char* tokenEnd = error.where;
+            while (tokenEnd != textEnd && !Detail::IsBlank(*tokenEnd)
+                   && *tokenEnd != '\n') {
+                ++tokenEnd;
+            }
+            throw std::runtime_error("Matrix::ReadFromFile: can't read \""
+                    + std::string(error.where, tokenEnd) + "\" at line "
+                    + line + " of " + path.string());
+        }
+        return Matrix(rows, cols, std::move(data));
+    }
+    static Matrix ReadFromFile(const std::string& filename,
+                               ThreadPool* pool = nullptr) {
+        File::path path = File::current_path() / filename;
+        return ReadFromFile(path, pool);
+    }
+    static Matrix ReadFromFile(const char* filename,
+                               ThreadPool* pool = nullptr) {
+        File::path path = File::current_path() / filename;
+        return ReadFromFile(path, pool);
+    }
+
+    void WriteBinary(const File::path& path) const {
+        Detail::BinaryMatrixHeader header;
+        header.elementType = static_cast<std::uint32_t>(
+                Detail::BinaryElementType<T>());
+        header.elementSize = sizeof(T);
+        header.rows = rows;
+        header.cols = cols;
+        auto headerBytes = Detail::EncodeBinaryMatrixHeader(header);
+
+        std::ofstream outStream(path.native(), std::ofstream::binary);
+        outStream.write(headerBytes.data(), headerBytes.size());
+        outStream.write(reinterpret_cast<const char*>(data.data()),
+                        data.size()*sizeof(T));
+        outStream.close();
+        if (outStream.fail()) {
+            throw std::runtime_error(__FILE__ ": could not write file at "
+                                     "provided path " + path.native());
+        }
+    }
+
+    static Matrix ReadBinary(const File::path& path) {
+        std::ifstream inStream(path.native(), std::ifstream::binary);
         if (inStream.fail()) {
             throw std::runtime_error(__FILE__ ": could not open file at "
                                      "provided path " + path.native());
         }
+        std::array<char, Detail::binaryMatrixHeaderSize> headerBytes{};
+        inStream.read(headerBytes.data(), headerBytes.size());
+        auto header = Detail::DecodeBinaryMatrixHeader<T>(
+                headerBytes.data(), File::file_size(path), path);
 
-        std::size_t rows = 0;
-        std::size_t cols = 0;
-        std::vector<T> data;
-        std::string line;
-        while (std::getline(inStream, line)) {
-            std::istringstream iss(line);
-            T value;
-            std::size_t colsOnThisLine = 0;
-            while (iss >> value) {
-                data.push_back(value);
-                ++colsOnThisLine;
-            }
-            if (cols == 0) cols = colsOnThisLine;
-            if (cols != colsOnThisLine) {
-                throw std::runtime_error("Matrix::ReadFromFile: matrix not "
-                                         "rectangular (row lengths differ).");
+        std::vector<T> elements(header.rows*header.cols);
+        inStream.seekg(header.dataOffset);
+        inStream.read(reinterpret_cast<char*>(elements.data()),
+                      elements.size()*sizeof(T));
+        if (inStream.fail()) {
+            throw std::runtime_error(__FILE__ ": could not read file at "
+                                     "provided path " + path.native());
+        }
+        if (header.swapped) {
+            for (T& x : elements) x = Detail::ByteSwapped(x);
+        }
+        return Matrix(header.rows, header.cols, std::move(elements));
+    }
+
+    std::string ToText(bool aligned = false) const {
+        std::string text;
+        FormatText(aligned, [&](const std::string& piece){ text += piece; });
+        return text;
+    }
+
+    void WriteToFile(const File::path& path, bool aligned = false) const {
+        std::ofstream outStream(path.native(), std::ofstream::binary);
+        FormatText(aligned, [&](const std::string& piece){
+            outStream.write(piece.data(), piece.size());
+        });
+        outStream.close();
+        if (outStream.fail()) {
+            throw std::runtime_error(__FILE__ ": could not write file at "
+                                     "provided path " + path.native());
+        }
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const Matrix& mat) {
+        for (size_type i = 0; i < mat.rows; ++i) {
+            if (i > 0) os << '\n';
+            const T* row = mat.Row(i);
+            for (size_type j = 0; j < mat.cols; ++j) {
+                if (j > 0) os << ' ';
+                os << row[j];
             }
-            ++rows;
         }
+        return os;
+    }
 
-        Matrix output(rows, cols);
-        output.data = data;
-        return output;
+    friend Matrix operator*(const Matrix& a, const Matrix& b) {
+        if (a.cols != b.rows) {
+            throw std::invalid_argument("LCH::Matrix: can't multiply " 
+                + std::to_string(a.rows) + "x" + std::to_string(a.cols)
+                + " by " + std::to_string(b.rows) + "x"
+                + std::to_string(b.cols));
+        }
+        Matrix product(a.rows, b.cols);
+        Detail::Gemm(a.rows, b.cols, a.cols, T(1), a.Data(), b.Data(), T(0),
+                     product.Data());
+        return product;
     }
-    static Matrix ReadFromFile(const std::string& filename) {
-        File::path path = File::current_path() / filename;
-        return ReadFromFile(path);
+
+  private:
+    Matrix(size_type rows, size_type cols, std::vector<T>&& data):
+            rows(rows), cols(cols), data(std::move(data)) {}
+
+    // Formats the matrix as text, passing it to flush a buffer at a time.
+    template<class Flush>
+    void FormatText(bool aligned, const Flush& flush) const {
+        std::string buffer;
+        buffer.reserve(Detail::textWriteBufferSize + 256);
+        auto flushIfFull = [&](){
+            if (buffer.size() >= Detail::textWriteBufferSize) {
+                flush(buffer);
+                buffer.clear();
+            }
+        };
+
+        if (!aligned) {
+            for (size_type i = 0; i < rows; ++i) {
+                const T* row = Row(i);
+                for (size_type j = 0; j < cols; ++j) {
+                    if (j > 0) buffer.push_back(' ');
+                    Detail::AppendTextValue(buffer, row[j]);
+                }
+                buffer.push_back('\n');
+                flushIfFull();
+            }
+        } else {
+            // Each element's text goes into one string (ends[n] is where that
+            // of element n ends) while the widest in each column is found.
+            std::string elements;
+            std::vector<std::size_t> ends(data.size());
+            std::vector<std::size_t> widths(cols, 0);
+            for (std::size_t i = 0, n = 0; i < rows; ++i) {
+                for (std::size_t j = 0; j < cols; ++j, ++n) {
+                    std::size_t start = elements.size();
+                    Detail::AppendTextValue(elements, data[n]);
+                    ends[n] = elements.size();
+                    widths[j] = std::max(widths[j], ends[n] - start);
+                }
+            }
+            std::size_t start = 0;
+            for (size_type i = 0; i < rows; ++i) {
+                for (size_type j = 0; j < cols; ++j) {
+                    std::size_t end = ends[i*cols + j];
+                    buffer.append(widths[j] - (end - start) + (j > 0), ' ');
+                    buffer.append(elements, start, end - start);
+                    start = end;
+                }
+                buffer.push_back('\n');
+                flushIfFull();
+            }
+        }
+        if (!buffer.empty()) flush(buffer);
     }
-    static Matrix ReadFromFile(const char* filename) {
-        File::path path = File::current_path() / filename;
-        return ReadFromFile(path);
+
+    void CheckAssignable(size_type otherRows, size_type otherCols) const {
+        if (otherRows != rows || otherCols != cols) {
+            throw std::invalid_argument("LCH::Matrix: can't assign "
+                + std::to_string(otherRows) + "x" + std::to_string(otherCols)
+                + " to " + std::to_string(rows) + "x" + std::to_string(cols));
+        }
+    }
+
+    template<class Expression>
+    void Evaluate(const Expression& expression) {
+        T* out = data.data();
+        const size_type size = data.size();
+        for (size_type i = 0; i < size; ++i) {
+            out[i] = static_cast<T>(expression[i]);
+        }
+    }
+};
+
+namespace Detail {
+    // An operand which is a Matrix (or MappedMatrix), read through a pointer
+    // so that evaluating an expression is a plain loop over arrays.
+    template<class T>
+    class MatrixLeaf : public MatrixExpressionTag {
+      public:
+        using value_type = T;
+
+        MatrixLeaf(const T* data, std::size_t rows, std::size_t cols) noexcept:
+                data(data), rows(rows), cols(cols) {}
+
+        std::size_t Rows() const noexcept { return rows; }
+        std::size_t Cols() const noexcept { return cols; }
+        const T& operator[](std::size_t i) const noexcept { return data[i]; }
+
+      private:
+        const T* data;
+        std::size_t rows;
+        std::size_t cols;
+    };
+
+    // Expressions are stored by value (they're small) and matrices by leaf.
+    template<class E>
+    auto AsNode(const E& expression) noexcept {
+        if constexpr (matrix_node<E>) {
+            return expression;
+        } else {
+            return MatrixLeaf<typename E::value_type>(
+                    expression.Data(), expression.Rows(), expression.Cols());
+        }
+    }
+
+    template<class Operation, class Operand>
+    class MatrixUnary : public MatrixExpressionTag {
+      public:
+        using value_type = std::decay_t<std::invoke_result_t<
+                const Operation&, typename Operand::value_type>>;
+
+        MatrixUnary(Operation operation, Operand operand):
+                operation(std::move(operation)), operand(std::move(operand)) {}
+
+        std::size_t Rows() const noexcept { return operand.Rows(); }
+        std::size_t Cols() const noexcept { return operand.Cols(); }
+        value_type operator[](std::size_t i) const {
+            return operation(operand[i]);
+        }
+
+      private:
+        Operation operation;
+        Operand operand;
+    };
+
+    template<class Operation, class Left, class Right>
+    class MatrixBinary : public MatrixExpressionTag {
+      public:
+        using value_type = std::decay_t<std::invoke_result_t<
+                const Operation&, typename Left::value_type,
+                typename Right::value_type>>;
+
+        MatrixBinary(Operation operation, Left left, Right right):
+                operation(std::move(operation)), left(std::move(left)),
+                right(std::move(right)) {
+            if (this->left.Rows() != this->right.Rows()
+                || this->left.Cols() != this->right.Cols()) {
+                throw std::invalid_argument("LCH::Matrix: element-wise "
+                    "operation on " + std::to_string(this->left.Rows()) + "x"
+                    + std::to_string(this->left.Cols()) + " and "
+                    + std::to_string(this->right.Rows()) + "x"
+                    + std::to_string(this->right.Cols()));
+            }
+        }
+
+        std::size_t Rows() const noexcept { return left.Rows(); }
+        std::size_t Cols() const noexcept { return left.Cols(); }
+        value_type operator[](std::size_t i) const {
+            return operation(left[i], right[i]);
+        }
+
+      private:
+        Operation operation;
+        Left left;
+        Right right;
+    };
+
+    template<class Operation, class E>
+    auto MakeUnary(Operation operation, const E& operand) {
+        using Operand = decltype(AsNode(operand));
+        return MatrixUnary<Operation, Operand>(std::move(operation),
+                                               AsNode(operand));
+    }
+
+    template<class Operation, class L, class R>
+    auto MakeBinary(Operation operation, const L& left, const R& right) {
+        using Left = decltype(AsNode(left));
+        using Right = decltype(AsNode(right));
+        return MatrixBinary<Operation, Left, Right>(
+                std::move(operation), AsNode(left), AsNode(right));
+    }
+
+    template<class L, class R>
+    constexpr bool matrix_operands = matrix_expression<L>
+                                     && matrix_expression<R>;
+} // namespace Detail
+
+template<class L, class R,
+         std::enable_if_t<Detail::matrix_operands<L, R>, bool> = true>
+auto operator+(const L& left, const R& right) {
+    return Detail::MakeBinary(std::plus<>(), left, right);
+}
+
+template<class L, class R,
+         std::enable_if_t<Detail::matrix_operands<L, R>, bool> = true>
+auto operator-(const L& left, const R& right) {
+    return Detail::MakeBinary(std::minus<>(), left, right);
+}
+
+template<class E,
+         std::enable_if_t<Detail::matrix_expression<E>, bool> = true>
+auto operator-(const E& operand) {
+    return Detail::MakeUnary(std::negate<>(), operand);
+}
+
+template<class E,
+         std::enable_if_t<Detail::matrix_expression<E>, bool> = true>
+auto operator*(const E& operand, const typename E::value_type& scalar) {
+    return Detail::MakeUnary([scalar](const auto& x){ return x*scalar; },
+                             operand);
+}
+
+template<class E,
+         std::enable_if_t<Detail::matrix_expression<E>, bool> = true>
+auto operator*(const typename E::value_type& scalar, const E& operand) {
+    return Detail::MakeUnary([scalar](const auto& x){ return scalar*x; },
+                             operand);
+}
+
+template<class E,
+         std::enable_if_t<Detail::matrix_expression<E>, bool> = true>
+auto operator/(const E& operand, const typename E::value_type& scalar) {
+    return Detail::MakeUnary([scalar](const auto& x){ return x/scalar; },
+                             operand);
+}
+
+template<class L, class R,
+         std::enable_if_t<Detail::matrix_operands<L, R>, bool> = true>
+auto ElementwiseProduct(const L& left, const R& right) {
+    return Detail::MakeBinary(std::multiplies<>(), left, right);
+}
+
+template<class L, class R,
+         std::enable_if_t<Detail::matrix_operands<L, R>, bool> = true>
+auto ElementwiseQuotient(const L& left, const R& right) {
+    return Detail::MakeBinary(std::divides<>(), left, right);
+}
+
+template<class E, class Function,
+         std::enable_if_t<Detail::matrix_expression<E>, bool> = true>
+auto Apply(const E& operand, Function function) {
+    return Detail::MakeUnary(std::move(function), operand);
+}
+
+// The matrix product of anything but two Matrix<T>s (which the Matrix class
+// handles itself, and which overload resolution prefers) evaluates both sides
+// into matrices first.
+template<class L, class R,
+         std::enable_if_t<Detail::matrix_operands<L, R>, bool> = true>
+auto operator*(const L& left, const R& right) {
+    using T = std::common_type_t<typename L::value_type,
+                                 typename R::value_type>;
+    return Matrix<T>(Detail::AsNode(left))*Matrix<T>(Detail::AsNode(right));
+}
+
+// c = alpha*a*b + beta*c
+template<typename T>
+void Gemm(typename Matrix<T>::value_type alpha, const Matrix<T>& a,
+          const Matrix<T>& b, typename Matrix<T>::value_type beta,
+          Matrix<T>& c) {
+    if (a.Cols() != b.Rows() || c.Rows() != a.Rows() || c.Cols() != b.Cols()) {
+        throw std::invalid_argument("LCH::Gemm: matrix dimensions don't "
+                                    "match");
+    }
+    if (&c == &a || &c == &b) {
+        throw std::invalid_argument("LCH::Gemm: output can't also be an "
+                                    "input");
+    }
+    Detail::Gemm(a.Rows(), b.Cols(), a.Cols(), alpha, a.Data(), b.Data(),
+                 beta, c.Data());
+}
+
+template<typename T>
+class MappedMatrix {
+  public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef std::array<size_type,2> Coords;
+    typedef Detail::MatrixRowIterator<const T> const_iterator;
+    typedef const_iterator iterator;
+
+  private:
+    MappedFile file;
+    const T* data = nullptr;
+    size_type rows = 0;
+    size_type cols = 0;
+
+  public:
+    explicit MappedMatrix(const File::path& path): file(path) {
+        auto header = Detail::DecodeBinaryMatrixHeader<T>(file.Data(),
+                                                          file.Size(), path);
+        if (header.swapped) {
+            throw std::runtime_error("LCH::MappedMatrix: " + path.string()
+                + " was written in the other byte order; use "
+                "Matrix::ReadBinary");
+        }
+        const char* first = file.Data() + header.dataOffset;
+        if (reinterpret_cast<std::uintptr_t>(first) % alignof(T) != 0) {
+            throw std::runtime_error("LCH::MappedMatrix: the elements in "
+                                     + path.string() + " aren't aligned");
+        }
+        data = reinterpret_cast<const T*>(first);
+        rows = header.rows;
+        cols = header.cols;
+    }
+
+    const T& operator()(size_type row, size_type col) const {
+        if (row >= rows || col >= cols) {
+            throw std::out_of_range("LCH::MappedMatrix: ("
+                + std::to_string(row) + ", " + std::to_string(col)
+                + ") is outside a " + std::to_string(rows) + "x"
+                + std::to_string(cols) + " matrix");
+        }
+        return data[row*cols + col];
+    }
+    const T& operator()(const Coords& coords) const {
+        return (*this)(coords[0], coords[1]);
+    }
+
+    size_type Rows() const noexcept { return rows; }
+    size_type Cols() const noexcept { return cols; }
+
+    const T& Unchecked(size_type row, size_type col) const noexcept {
+        return data[row*cols + col];
+    }
+    const T* Row(size_type row) const noexcept { return data + row*cols; }
+    const T* Data() const noexcept { return data; }
+
+    const_iterator begin() const noexcept { return {data, 0, cols}; }
+    const_iterator end() const noexcept { return {data, rows, cols}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+};
+
+namespace Detail {
+    // f(0), f(1), ..., f(N - 1) into an array, written out in full.
+    template<class T, class F, std::size_t... I>
+    constexpr std::array<T, sizeof...(I)> UnrolledArray(
+            const F& f, std::index_sequence<I...>) {
+        return {{f(I)...}};
+    }
+
+    template<class T, std::size_t N, class F>
+    constexpr std::array<T, N> UnrolledArray(const F& f) {
+        return UnrolledArray<T>(f, std::make_index_sequence<N>());
+    }
+
+    // The dot product of row i of an R x K matrix and column j of a K x C one.
+    template<class T, std::size_t K, std::size_t C, std::size_t... P>
+    constexpr T UnrolledDot(const T* a, const T* b, std::size_t i,
+                            std::size_t j, std::index_sequence<P...>) {
+        return (T(0) + ... + (a[i*K + P]*b[P*C + j]));
+    }
+} // namespace Detail
+
+template<typename T, std::size_t R, std::size_t C>
+class Matrix {
+    static_assert(R != dynamicExtent && C != dynamicExtent,
+                  "LCH::Matrix: dimensions are either both fixed or both "
+                  "dynamic");
+
+  public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef std::array<size_type,2> Coords;
+    typedef Detail::MatrixRowIterator<T> iterator;
+    typedef Detail::MatrixRowIterator<const T> const_iterator;
+
+  private:
+    std::array<T, R*C> data{};
+
+  public:
+    constexpr Matrix() = default;
+    constexpr Matrix(const std::array<T, R*C>& elements): data(elements) {}
+
+    explicit Matrix(const Matrix<T>& dynamic) {
+        if (dynamic.Rows() != R || dynamic.Cols() != C) {
+            throw std::invalid_argument("LCH::Matrix: can't make a "
+                + std::to_string(R) + "x" + std::to_string(C) + " matrix "
+                "from a " + std::to_string(dynamic.Rows()) + "x"
+                + std::to_string(dynamic.Cols()) + " one");
+        }
+        std::copy(dynamic.Data(), dynamic.Data() + R*C, data.begin());
+    }
+
+    static constexpr Matrix Identity() {
+        static_assert(R == C, "LCH::Matrix: only square matrices have an "
+                              "identity");
+        return Detail::UnrolledArray<T, R*C>([](std::size_t n){
+            return n/C == n%C ? T(1) : T(0);
+        });
+    }
+
+    static constexpr size_type Rows() noexcept { return R; }
+    static constexpr size_type Cols() noexcept { return C; }
+
+    constexpr T& operator()(size_type row, size_type col) {
+        return data[CheckedIndex(row, col)];
+    }
+    constexpr T& operator()(const Coords& coords) {
+        return (*this)(coords[0], coords[1]);
+    }
+    constexpr const T& operator()(size_type row, size_type col) const {
+        return data[CheckedIndex(row, col)];
+    }
+    constexpr const T& operator()(const Coords& coords) const {
+        return (*this)(coords[0], coords[1]);
+    }
+
+    constexpr T& Unchecked(size_type row, size_type col) noexcept {
+        return data[row*C + col];
+    }
+    constexpr const T& Unchecked(size_type row, size_type col) const noexcept {
+        return data[row*C + col];
+    }
+
+    constexpr T* Row(size_type row) noexcept { return data.data() + row*C; }
+    constexpr const T* Row(size_type row) const noexcept {
+        return data.data() + row*C;
+    }
+
+    constexpr T* Data() noexcept { return data.data(); }
+    constexpr const T* Data() const noexcept { return data.data(); }
+
+    iterator begin() noexcept { return {data.data(), 0, C}; }
+    iterator end() noexcept { return {data.data(), R, C}; }
+    const_iterator begin() const noexcept { return {data.data(), 0, C}; }
+    const_iterator end() const noexcept { return {data.data(), R, C}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    constexpr Matrix<T, C, R> Transposed() const {
+        return Detail::UnrolledArray<T, R*C>([this](std::size_t n){
+            return data[(n%R)*C + n/R];
+        });
+    }
+
+    friend constexpr Matrix operator+(const Matrix& a, const Matrix& b) {
+        return Detail::UnrolledArray<T, R*C>([&](std::size_t n){
+            return a.data[n] + b.data[n];
+        });
+    }
+    friend constexpr Matrix operator-(const Matrix& a, const Matrix& b) {
+        return Detail::UnrolledArray<T, R*C>([&](std::size_t n){
+            return a.data[n] - b.data[n];
+        });
+    }
+    friend constexpr Matrix operator-(const Matrix& a) {
+        return Detail::UnrolledArray<T, R*C>([&](std::size_t n){
+            return -a.data[n];
+        });
+    }
+    friend constexpr Matrix operator*(const Matrix& a, const T& scalar) {
+        return Detail::UnrolledArray<T, R*C>([&](std::size_t n){
+            return a.data[n]*scalar;
+        });
+    }
+    friend constexpr Matrix operator*(const T& scalar, const Matrix& a) {
+        return Detail::UnrolledArray<T, R*C>([&](std::size_t n){
+            return scalar*a.data[n];
+        });
+    }
+    friend constexpr Matrix operator/(const Matrix& a, const T& scalar) {
+        return Detail::UnrolledArray<T, R*C>([&](std::size_t n){
+            return a.data[n]/scalar;
+        });
+    }
+
+    template<std::size_t K>
+    friend constexpr Matrix<T, R, K> operator*(const Matrix& a,
+                                               const Matrix<T, C, K>& b) {
+        return Detail::UnrolledArray<T, R*K>([&](std::size_t n){
+            return Detail::UnrolledDot<T, C, K>(a.Data(), b.Data(), n/K, n%K,
+                    std::make_index_sequence<C>());
+        });
+    }
+
+    constexpr Matrix& operator+=(const Matrix& other) {
+        return *this = *this + other;
+    }
+    constexpr Matrix& operator-=(const Matrix& other) {
+        return *this = *this - other;
+    }
+    constexpr Matrix& operator*=(const T& scalar) {
+        return *this = *this*scalar;
+    }
+    constexpr Matrix& operator/=(const T& scalar) {
+        return *this = *this/scalar;
+    }
+
+    friend constexpr bool operator==(const Matrix& a, const Matrix& b) {
+        for (size_type n = 0; n < R*C; ++n) {
+            if (!(a.data[n] == b.data[n])) return false;
+        }
+        return true;
+    }
+    friend constexpr bool operator!=(const Matrix& a, const Matrix& b) {
+        return !(a == b);
     }
 
-    // TODO: buffer into columns first, then check widths and format everything
-    // to line up
     friend std::ostream& operator<<(std::ostream& os, const Matrix& mat) {
-        size_type i = 0;
-        while (i < mat.rows*mat.cols - 1) {
-            os << mat.data[i];
-            ++i;
-            if (i%mat.cols >= 1) os << ' ';
-            if (i%mat.cols == 0) os << '\n';
-        }
-        return os << mat.data[i];
+        for (size_type i = 0; i < R; ++i) {
+            for (size_type j = 0; j < C; ++j) {
+                os << mat.data[i*C + j] << (j + 1 < C ? " " : "");
+            }
+            if (i + 1 < R) os << '\n';
+        }
+        return os;
+    }
+
+  private:
+    static constexpr size_type CheckedIndex(size_type row, size_type col) {
+        if (row >= R || col >= C) {
+            throw std::out_of_range("LCH::Matrix: (" + std::to_string(row)
+                + ", " + std::to_string(col) + ") is outside a "
+                + std::to_string(R) + "x" + std::to_string(C) + " matrix");
+        }
+        return row*C + col;
     }
 };
 
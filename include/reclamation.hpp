@@ -0,0 +1,572 @@
+///////////////////////////////////////////////////////////////////////////////
+// reclamation.hpp: safe memory reclamation for lock-free containers. When a
+// node is unlinked from a lock-free structure, other threads may still be
+// reading it, so it can't be deleted right away; instead it is "retired" to a
+// domain, which deletes it once no reader can still be holding it.
+//
+// Two kinds of domain are provided:
+//
+// EpochDomain uses epoch-based reclamation. Readers Pin() the domain for the
+// duration of a read-side critical section, and anything retired while they
+// are pinned is kept alive until they unpin. Pinning is very cheap, but a
+// reader that stays pinned forever prevents anything from being freed.
+//
+// LCH::EpochDomain domain;
+// {
+//     auto guard = domain.Pin();
+//     Node* node = head.load(std::memory_order_acquire);
+//     ... // node can't be deleted until guard is destroyed
+// }
+// domain.Retire(oldNode); // after oldNode has been unlinked by a writer
+//
+// HazardPointerDomain uses hazard pointers. Readers protect individual
+// pointers rather than whole critical sections, so a stalled reader can only
+// keep a handful of nodes alive, at the cost of a fence for every protected
+// load. Each thread may hold up to HazardPointerDomain::slotsPerThread hazard
+// pointers in a given domain at once.
+//
+// LCH::HazardPointerDomain::Holder hazard(domain);
+// Node* node = hazard.Protect(head); // valid until hazard is reset/destroyed
+//
+// Both domains keep a separate retire list for each thread and only scan the
+// other threads once that list reaches the domain's batch size, so the cost of
+// the scan is shared by a whole batch of frees. A thread registers with a
+// domain the first time it uses it; when it exits, its registration is
+// recycled and anything it retired which couldn't be freed yet is handed over
+// to the domain to be freed by someone else.
+//
+// WARNING: a domain frees everything still retired to it when it's destroyed,
+// so (as with AtomicQueue) don't destroy one while anyone is still using it.
+// If you don't want to manage a domain yourself, use Default(), which returns
+// a domain of each type that lives for the whole program.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2018-2019 by Joyz Inc of Tokyo, Japan (author: Charles Hussong) //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCH_RECLAMATION_HPP
+#define LCH_RECLAMATION_HPP
+
+#include "hardware.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace LCH {
+
+namespace Detail {
+
+// A pointer waiting to be freed, the function which will free it, and the
+// epoch in which it was retired (only used by EpochDomain).
+struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    std::uint64_t epoch;
+};
+
+template<typename T>
+void DeleteRetired(void* ptr) {
+    delete static_cast<T*>(ptr);
+}
+
+// Frees everything in retired. A deleter may itself retire something to the
+// same list (e.g. a destructor which retires a member), so the entries are
+// moved out before any of them are freed, until none are left.
+inline std::size_t FreeRetired(std::vector<Retired>& retired) {
+    std::size_t count = 0;
+    while (!retired.empty()) {
+        std::vector<Retired> freeing;
+        freeing.swap(retired);
+        for (const Retired& r : freeing) r.deleter(r.ptr);
+        count += freeing.size();
+    }
+    return count;
+}
+
+// The part of a domain which is shared with the threads registered to it. It
+// keeps a lock-free list of per-thread records which is only ever added to;
+// records belonging to threads which have exited are marked free and handed
+// out again to the next thread that registers.
+//
+// Record must be default constructible and have the members
+// std::atomic<bool> inUse, Record* next, and std::vector<Retired> retired.
+template<class Record>
+class DomainState {
+  public:
+    DomainState() = default;
+    DomainState(const DomainState&) = delete;
+    DomainState& operator=(const DomainState&) = delete;
+
+    ~DomainState() {
+        Record* record = head.load(std::memory_order_acquire);
+        while (record != nullptr) {
+            Record* next = record->next;
+            FreeRetired(record->retired);
+            delete record;
+            record = next;
+        }
+        FreeRetired(orphans);
+    }
+
+    Record* Register() {
+        for (Record* record = head.load(std::memory_order_acquire);
+             record != nullptr; record = record->next) {
+            bool expected = false;
+            if (!record->inUse.load(std::memory_order_relaxed) &&
+                record->inUse.compare_exchange_strong(expected, true,
+                                                      std::memory_order_acq_rel)) {
+                return record;
+            }
+        }
+
+        Record* record = new Record;
+        record->inUse.store(true, std::memory_order_relaxed);
+        record->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(record->next, record,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {}
+        recordCount.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    // Called when the thread owning record exits; whatever it couldn't free
+    // is left for the other threads (or the domain's destructor) to free.
+    void Unregister(Record* record) {
+        if (alive.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(orphanMutex);
+            orphans.insert(orphans.end(), record->retired.begin(),
+                           record->retired.end());
+            record->retired.clear();
+        } else {
+            FreeRetired(record->retired);
+        }
+        record->inUse.store(false, std::memory_order_release);
+    }
+
+    // Called by the domain's destructor, after which no one should be using it
+    // (but threads may still hold registrations which they'll give up later).
+    void Shutdown() {
+        alive.store(false, std::memory_order_release);
+        std::vector<Retired> freeing;
+        {
+            std::lock_guard<std::mutex> lock(orphanMutex);
+            freeing.swap(orphans);
+        }
+        FreeRetired(freeing);
+        ForEachRecord([](Record& record){ FreeRetired(record.retired); });
+    }
+
+    bool Alive() const noexcept {
+        return alive.load(std::memory_order_acquire);
+    }
+
+    std::size_t RecordCount() const noexcept {
+        return recordCount.load(std::memory_order_relaxed);
+    }
+
+    template<class Function>
+    void ForEachRecord(Function&& function) {
+        for (Record* record = head.load(std::memory_order_acquire);
+             record != nullptr; record = record->next) {
+            function(*record);
+        }
+    }
+
+    // Frees the orphaned pointers for which canFree returns true, unless
+    // another thread is already doing so. Returns how many were freed. The
+    // lock is released before anything is freed, in case a deleter retires
+    // something and that starts another collection.
+    template<class Predicate>
+    std::size_t CollectOrphans(Predicate&& canFree) {
+        std::vector<Retired> freeing;
+        {
+            std::unique_lock<std::mutex> lock(orphanMutex, std::try_to_lock);
+            if (!lock.owns_lock() || orphans.empty()) return 0;
+            freeing = TakeFreeable(orphans, canFree);
+        }
+        return FreeRetired(freeing);
+    }
+
+    // Frees the entries of retired for which canFree returns true and removes
+    // them from the list. Returns how many were freed.
+    template<class Predicate>
+    static std::size_t CollectFrom(std::vector<Retired>& retired,
+                                   Predicate&& canFree) {
+        std::vector<Retired> freeing = TakeFreeable(retired, canFree);
+        return FreeRetired(freeing);
+    }
+
+  private:
+    // Removes the entries of retired for which canFree returns true and
+    // returns them, so that nothing touches retired while they're freed.
+    template<class Predicate>
+    static std::vector<Retired> TakeFreeable(std::vector<Retired>& retired,
+                                             Predicate& canFree) {
+        auto keep = std::partition(retired.begin(), retired.end(),
+                [&canFree](const Retired& r){ return !canFree(r); });
+        std::vector<Retired> freeing(keep, retired.end());
+        retired.erase(keep, retired.end());
+        return freeing;
+    }
+
+
+    std::atomic<Record*> head{nullptr};
+    std::atomic<std::size_t> recordCount{0};
+    std::atomic<bool> alive{true};
+
+    std::mutex orphanMutex;
+    std::vector<Retired> orphans;
+};
+
+// Finds the calling thread's record in the domain with the given state,
+// registering it if necessary. Each thread caches its records, and gives them
+// back to their domains when it exits.
+template<class State>
+class ThreadRecords {
+  public:
+    using Record = typename State::Record;
+
+    ThreadRecords() = default;
+    ThreadRecords(const ThreadRecords&) = delete;
+    ThreadRecords& operator=(const ThreadRecords&) = delete;
+
+    ~ThreadRecords() {
+        for (auto& entry : entries) entry.state->Unregister(entry.record);
+    }
+
+    static Record& Get(const std::shared_ptr<State>& state) {
+        static thread_local ThreadRecords local;
+        return local.Find(state);
+    }
+
+  private:
+    struct Entry {
+        std::shared_ptr<State> state;
+        Record* record;
+    };
+    std::vector<Entry> entries;
+
+    Record& Find(const std::shared_ptr<State>& state) {
+        for (const auto& entry : entries) {
+            if (entry.state == state) return *entry.record;
+        }
+
+        // forget about any domains which have been destroyed in the meantime
+        auto dead = std::remove_if(entries.begin(), entries.end(),
+                [](const Entry& entry){ return !entry.state->Alive(); });
+        for (auto it = dead; it != entries.end(); ++it) {
+            it->state->Unregister(it->record);
+        }
+        entries.erase(dead, entries.end());
+
+        entries.push_back({state, state->Register()});
+        return *entries.back().record;
+    }
+};
+
+} // namespace Detail
+
+// Epoch-based reclamation domain; see the top of the file for usage. A thread
+// is pinned as long as it holds at least one Guard, and pins can be nested.
+// Something retired in epoch e is freed once the global epoch reaches e + 2,
+// which can only happen after every thread pinned in epoch e has unpinned.
+class EpochDomain {
+  private:
+    struct alignas(cacheLineSize) Record {
+        // (epoch << 1) | 1 while the owning thread is pinned, 0 otherwise
+        std::atomic<std::uint64_t> pinnedEpoch{0};
+        std::atomic<bool> inUse{false};
+        Record* next = nullptr;
+
+        // only touched by the owning thread
+        std::size_t pinDepth = 0;
+        std::vector<Detail::Retired> retired;
+    };
+
+    struct State : Detail::DomainState<Record> {
+        using Record = EpochDomain::Record;
+
+        std::atomic<std::uint64_t> epoch{0};
+    };
+
+  public:
+    // Keeps the calling thread pinned for as long as it exists. Guards are
+    // tied to the thread which created them, so don't pass them to others.
+    class Guard {
+      public:
+        Guard(Guard&& other) noexcept: record(other.record) {
+            other.record = nullptr;
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+
+        ~Guard() {
+            if (record != nullptr && --record->pinDepth == 0) {
+                record->pinnedEpoch.store(0, std::memory_order_release);
+            }
+        }
+
+      private:
+        friend class EpochDomain;
+        explicit Guard(Record* record) noexcept: record(record) {}
+
+        Record* record;
+    };
+
+    // Pointers are only freed once a thread has retired batchSize of them; a
+    // larger batch makes each scan of the other threads cheaper per pointer,
+    // but lets more memory pile up before it's reclaimed.
+    explicit EpochDomain(std::size_t batchSize = 64):
+            state(std::make_shared<State>()), batchSize(batchSize) {}
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    ~EpochDomain() { state->Shutdown(); }
+
+    static EpochDomain& Default() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    Guard Pin() {
+        Record& record = LocalRecord();
+        if (record.pinDepth++ == 0) {
+            std::uint64_t epoch = state->epoch.load(std::memory_order_relaxed);
+            record.pinnedEpoch.store((epoch << 1) | 1,
+                                     std::memory_order_relaxed);
+            // pairs with the fence in TryAdvance: either the advancing thread
+            // sees this pin, or we see everything it saw
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        return Guard(&record);
+    }
+
+    // Hand over ownership of ptr, which will be freed with deleter once no
+    // pinned thread can still be using it. ptr must already be unreachable
+    // for any thread which pins after this call.
+    void Retire(void* ptr, void (*deleter)(void*)) {
+        Record& record = LocalRecord();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::uint64_t epoch = state->epoch.load(std::memory_order_relaxed);
+        record.retired.push_back({ptr, deleter, epoch});
+        if (record.retired.size() >= batchSize) Collect(record);
+    }
+
+    template<typename T>
+    void Retire(T* ptr) {
+        Retire(const_cast<void*>(static_cast<const void*>(ptr)),
+               &Detail::DeleteRetired<T>);
+    }
+
+    // Try to advance the epoch, then free whatever this thread (or an exited
+    // thread) has retired which is now safe to free. This happens
+    // automatically once a batch has been retired, so you only need to call it
+    // if you want memory back sooner. Returns the number of pointers freed.
+    std::size_t Collect() { return Collect(LocalRecord()); }
+
+  private:
+    std::shared_ptr<State> state;
+    const std::size_t batchSize;
+
+    Record& LocalRecord() {
+        return Detail::ThreadRecords<State>::Get(state);
+    }
+
+    // The epoch can only advance if every pinned thread has seen the current
+    // one. Returns the epoch after the attempt.
+    std::uint64_t TryAdvance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::uint64_t epoch = state->epoch.load(std::memory_order_relaxed);
+        bool everyoneCurrent = true;
+        state->ForEachRecord([&](const Record& record){
+            std::uint64_t pinned =
+                record.pinnedEpoch.load(std::memory_order_acquire);
+            if ((pinned & 1) && (pinned >> 1) != epoch) {
+                everyoneCurrent = false;
+            }
+        });
+        if (everyoneCurrent &&
+            state->epoch.compare_exchange_strong(epoch, epoch + 1,
+                                                 std::memory_order_acq_rel)) {
+            return epoch + 1;
+        }
+        return epoch;
+    }
+
+    std::size_t Collect(Record& record) {
+        std::uint64_t epoch = TryAdvance();
+        auto canFree = [epoch](const Detail::Retired& r){
+            return r.epoch + 2 <= epoch;
+        };
+        return State::CollectFrom(record.retired, canFree)
+            + state->CollectOrphans(canFree);
+    }
+};
+
+// Hazard pointer reclamation domain; see the top of the file for usage. A
+// pointer is only freed if no Holder was protecting it at the time of the
+// scan which would free it.
+class HazardPointerDomain {
+  public:
+    static constexpr std::size_t slotsPerThread = 8;
+
+  private:
+    struct alignas(cacheLineSize) Record {
+        std::array<std::atomic<const void*>, slotsPerThread> hazards{};
+        std::atomic<bool> inUse{false};
+        Record* next = nullptr;
+
+        // only touched by the owning thread
+        std::array<bool, slotsPerThread> slotTaken{};
+        std::vector<Detail::Retired> retired;
+    };
+
+    struct State : Detail::DomainState<Record> {
+        using Record = HazardPointerDomain::Record;
+    };
+
+  public:
+    // Owns one of the calling thread's hazard pointer slots for as long as it
+    // exists. Like EpochDomain::Guard, don't pass these to other threads.
+    class Holder {
+      public:
+        explicit Holder(HazardPointerDomain& domain = Default()) {
+            Record& record = domain.LocalRecord();
+            for (std::size_t i = 0; i < slotsPerThread; ++i) {
+                if (!record.slotTaken[i]) {
+                    record.slotTaken[i] = true;
+                    slot = &record.hazards[i];
+                    taken = &record.slotTaken[i];
+                    return;
+                }
+            }
+            throw std::length_error("LCH::HazardPointerDomain::Holder: this "
+                                    "thread already holds the maximum number "
+                                    "of hazard pointers in this domain");
+        }
+        Holder(const Holder&) = delete;
+        Holder& operator=(const Holder&) = delete;
+
+        ~Holder() {
+            Reset();
+            *taken = false;
+        }
+
+        // Load the pointer from source and protect it, retrying until the
+        // protected value is still the current one.
+        template<typename T>
+        T* Protect(const std::atomic<T*>& source) noexcept {
+            T* ptr = source.load(std::memory_order_relaxed);
+            while (true) {
+                Set(ptr);
+                T* again = source.load(std::memory_order_acquire);
+                if (again == ptr) return ptr;
+                ptr = again;
+            }
+        }
+
+        // Protect ptr without checking that it's still reachable; you must
+        // check this yourself after calling Set.
+        template<typename T>
+        void Set(T* ptr) noexcept {
+            slot->store(ptr, std::memory_order_relaxed);
+            // pairs with the fence in Scan
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        void Reset() noexcept {
+            slot->store(nullptr, std::memory_order_release);
+        }
+
+      private:
+        std::atomic<const void*>* slot = nullptr;
+        bool* taken = nullptr;
+    };
+
+    // As for EpochDomain, but the batch size is also never allowed to be less
+    // than twice the total number of hazard pointer slots, so that every scan
+    // frees at least half of the batch.
+    explicit HazardPointerDomain(std::size_t batchSize = 64):
+            state(std::make_shared<State>()), batchSize(batchSize) {}
+
+    HazardPointerDomain(const HazardPointerDomain&) = delete;
+    HazardPointerDomain& operator=(const HazardPointerDomain&) = delete;
+
+    ~HazardPointerDomain() { state->Shutdown(); }
+
+    static HazardPointerDomain& Default() {
+        static HazardPointerDomain domain;
+        return domain;
+    }
+
+    void Retire(void* ptr, void (*deleter)(void*)) {
+        Record& record = LocalRecord();
+        record.retired.push_back({ptr, deleter, 0});
+        std::size_t threshold = std::max(batchSize,
+                2*slotsPerThread*state->RecordCount());
+        if (record.retired.size() >= threshold) Collect(record);
+    }
+
+    template<typename T>
+    void Retire(T* ptr) {
+        Retire(const_cast<void*>(static_cast<const void*>(ptr)),
+               &Detail::DeleteRetired<T>);
+    }
+
+    // Free whatever this thread (or an exited thread) has retired which isn't
+    // currently protected. Returns the number of pointers freed.
+    std::size_t Collect() { return Collect(LocalRecord()); }
+
+  private:
+    std::shared_ptr<State> state;
+    const std::size_t batchSize;
+
+    Record& LocalRecord() {
+        return Detail::ThreadRecords<State>::Get(state);
+    }
+
+    std::size_t Collect(Record& record) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::vector<const void*> protectedPtrs;
+        state->ForEachRecord([&protectedPtrs](const Record& other){
+            for (const auto& hazard : other.hazards) {
+                const void* ptr = hazard.load(std::memory_order_acquire);
+                if (ptr != nullptr) protectedPtrs.push_back(ptr);
+            }
+        });
+        std::sort(protectedPtrs.begin(), protectedPtrs.end());
+
+        auto canFree = [&protectedPtrs](const Detail::Retired& r){
+            return !std::binary_search(protectedPtrs.begin(),
+                                       protectedPtrs.end(),
+                                       static_cast<const void*>(r.ptr));
+        };
+        return State::CollectFrom(record.retired, canFree)
+            + state->CollectOrphans(canFree);
+    }
+};
+
+} // namespace LCH
+
+#endif // LCH_RECLAMATION_HPP
@@ -60,6 +60,8 @@
 #ifndef LCH_THREAD_POOL_HPP
 #define LCH_THREAD_POOL_HPP
 
+#include "hardware.hpp"
+
 #include <thread>
 #include <mutex>
 #include <atomic>
@@ -80,7 +82,7 @@ class ThreadPool {
     // A default-constructed thread pool contains hardware_concurrency() threads
     explicit ThreadPool(std::size_t threadCount 
                         = std::thread::hardware_concurrency()):
-            finished(false), noMoreTasks(false), waiting(0) {
+            waiting(0), finished(false), noMoreTasks(false) {
         for (std::size_t i = 0; i < threadCount; ++i) {
             threads.emplace_back(&ThreadPool::WaitForTask, this);
         }
@@ -177,15 +179,24 @@ class ThreadPool {
     }
 
   protected:
-    std::mutex taskMutex;
-    std::condition_variable notifier;
+    // These are grouped by who writes them so that threads writing one group
+    // don't keep stealing the cache lines of threads reading another: the task
+    // queue changes hands between AddTask and the workers under taskMutex; the
+    // notifier is signalled outside the lock; waiting is updated by every
+    // worker as it goes to sleep; the flags are read on every AddTask but
+    // almost never written; and the threads are only touched on startup and 
+    // shutdown.
+    alignas(cacheLineSize) std::mutex taskMutex;
     std::queue<std::unique_ptr<AbstractTask>> tasks;
 
-    std::atomic<bool> finished;
+    alignas(cacheLineSize) std::condition_variable notifier;
+
+    alignas(cacheLineSize) std::atomic<std::size_t> waiting;
+
+    alignas(cacheLineSize) std::atomic<bool> finished;
     std::atomic<bool> noMoreTasks;
-    std::atomic<std::size_t> waiting;
 
-    std::mutex threadMutex;
+    alignas(cacheLineSize) std::mutex threadMutex;
     std::vector<std::thread> threads;
 
     // Each thread loops through this function until either the pool is marked
@@ -0,0 +1,99 @@
+// tests/allocations.cpp: checks that code meant not to allocate doesn't, by
+// counting calls to the global operator new. Replacing it affects the whole
+// program, so these tests are built into their own executable,
+// lch_allocation_test, rather than into lch_test with everything else.
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include "levenshtein.hpp"
+#include "levenshtein_utf8.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+
+// Counts this thread's allocations, to check that repeated distance
+// computations don't make any once their scratch memory has grown.
+thread_local std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    ++allocations;
+    return std::malloc(size == 0 ? 1 : size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+template<class Function>
+std::size_t AllocationsIn(const Function& f) {
+    f(); // the first call can grow the scratch memory
+    std::size_t before = allocations;
+    for (int i = 0; i < 100; ++i) f();
+    return allocations - before;
+}
+
+TEST_CASE("repeated Levenshtein distances don't allocate",
+          "[levenshtein]") {
+    std::mt19937 rng(36);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string shortA, shortB, longA, longB;
+    for (int i = 0; i < 40; ++i) shortA.push_back(char(letter(rng)));
+    for (int i = 0; i < 45; ++i) shortB.push_back(char(letter(rng)));
+    for (int i = 0; i < 150; ++i) longA.push_back(char(letter(rng)));
+    for (int i = 0; i < 170; ++i) longB.push_back(char(letter(rng)));
+    std::u32string wideA(longA.begin(), longA.end());
+    std::u32string wideB(longB.begin(), longB.end());
+    std::u32string shortWideA(shortA.begin(), shortA.end());
+    std::u32string shortWideB(shortB.begin(), shortB.end());
+    const std::string japaneseA = "\u3072\u3089\u304c\u306a\u3067\u3059abc";
+    const std::string japaneseB = "\u3072\u3089\u304b\u306a\u3067\u3059xbc";
+
+    CHECK(AllocationsIn([&](){
+        LCH::levenshtein_distance(shortA, shortB);
+        LCH::levenshtein_distance(longA, longB);
+        LCH::levenshtein_distance_bounded(longA, longB, 20);
+        LCH::osa_distance(longA, longB);
+    }) == 0);
+    CHECK(AllocationsIn([&](){
+        LCH::levenshtein_distance(shortWideA, shortWideB);
+        LCH::levenshtein_distance(wideA, wideB);
+        LCH::levenshtein_distance_bounded(wideA, wideB, 20);
+        LCH::osa_distance(wideA, wideB);
+    }) == 0);
+    const LCH::LevenshteinCosts weighted{2, 1, 1};
+    CHECK(AllocationsIn([&](){
+        LCH::levenshtein_distance(longA, longB, weighted);
+        LCH::levenshtein_distance(wideA, wideB, weighted);
+    }) == 0);
+    CHECK(AllocationsIn([&](){
+        LCH::utf8_levenshtein_distance(japaneseA, japaneseB);
+        LCH::utf8_levenshtein_distance_bounded(japaneseA, japaneseB, 3);
+    }) == 0);
+}
@@ -0,0 +1,249 @@
+#include "atomic_containers.hpp"
+#include "options.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2018-2019 by Joyz Inc of Tokyo, Japan (author: Charles Hussong) //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+LCH::Options MakeConfig(int generation) {
+    LCH::Options options;
+    options.Insert("generation", std::to_string(generation));
+    options.Insert("doubled", std::to_string(2*generation));
+    return options;
+}
+
+TEST_CASE("AtomicSnapshot publishes whole values", "[atomic_snapshot]") {
+    LCH::EpochDomain domain;
+    LCH::AtomicSnapshot<LCH::Options> config(MakeConfig(0), domain);
+
+    SECTION("snapshots outlive the values they were taken of") {
+        auto before = config.load();
+        config.store(MakeConfig(1));
+        auto after = config.load();
+        for (int i = 0; i < 3; ++i) domain.Collect();
+
+        CHECK(before->Value("generation") == "0");
+        CHECK(after->Value("generation") == "1");
+        CHECK(config.load()->Value("doubled") == "2");
+    }
+
+    SECTION("update modifies a copy of the current value") {
+        config.update([](LCH::Options& options){
+            options.Overwrite("generation", "5");
+        });
+        auto current = config.load();
+        CHECK(current->Value("generation") == "5");
+        CHECK(current->Value("doubled") == "0");
+    }
+
+    SECTION("null values are rejected") {
+        REQUIRE_THROWS_AS(config.store(std::unique_ptr<LCH::Options>()),
+                          std::invalid_argument);
+        CHECK(config.load()->Value("generation") == "0");
+    }
+
+    SECTION("readers always see a consistent value") {
+        constexpr int generations = 500;
+        std::atomic<bool> done{false};
+        std::atomic<bool> inconsistent{false};
+
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 3; ++t) {
+            readers.emplace_back([&](){
+                while (!done) {
+                    auto current = config.load();
+                    int generation = std::stoi(current->Value("generation"));
+                    int doubled = std::stoi(current->Value("doubled"));
+                    if (doubled != 2*generation) inconsistent = true;
+                }
+            });
+        }
+        for (int i = 1; i <= generations; ++i) config.store(MakeConfig(i));
+        done = true;
+        for (auto& reader : readers) reader.join();
+
+        CHECK(!inconsistent);
+        CHECK(config.load()->Value("generation") == std::to_string(generations));
+    }
+}
+
+class CountedConfig {
+  public:
+    explicit CountedConfig(int generation): generation(generation) {
+        alive += 1;
+    }
+    CountedConfig(const CountedConfig& other): generation(other.generation) {
+        alive += 1;
+    }
+    ~CountedConfig() { alive -= 1; }
+
+    static int Alive() { return alive; }
+
+    int generation;
+
+  private:
+    static std::atomic<int> alive;
+};
+
+std::atomic<int> CountedConfig::alive{0};
+
+TEST_CASE("AtomicSnapshot frees old values once they aren't being read",
+          "[atomic_snapshot]") {
+    LCH::EpochDomain domain;
+    {
+        LCH::AtomicSnapshot<CountedConfig> config(CountedConfig(0), domain);
+        REQUIRE(CountedConfig::Alive() == 1);
+
+        config.store(CountedConfig(1));
+        CHECK(CountedConfig::Alive() == 1);
+        config.update([](CountedConfig& value){ value.generation = 2; });
+        CHECK(CountedConfig::Alive() == 1);
+
+        {
+            auto old = config.load();
+            config.store(CountedConfig(3));
+            CHECK(CountedConfig::Alive() == 2);
+            CHECK(old->generation == 2);
+        }
+        config.store(CountedConfig(4));
+        CHECK(CountedConfig::Alive() == 1);
+        CHECK(config.load()->generation == 4);
+    }
+    domain.Collect();
+    domain.Collect();
+    CHECK(CountedConfig::Alive() == 0);
+}
+
+TEST_CASE("AtomicQueue can be locked for compound operations",
+          "[atomic_queue]") {
+    LCH::AtomicQueue<int> queue;
+    for (int i = 0; i < 5; ++i) queue.push(i);
+
+    SECTION("locked views have the full std::queue interface") {
+        auto view = queue.locked();
+        REQUIRE(view.size() == 5);
+        REQUIRE(!view.empty());
+        CHECK(view.front() == 0);
+        CHECK(view.back() == 4);
+        view.front() = 10;
+        view.pop();
+        view.emplace(5);
+        CHECK(view.front() == 1);
+        CHECK(view.back() == 5);
+
+        std::queue<int> other;
+        other.push(-1);
+        view.swap(other);
+        CHECK(view.size() == 1);
+        CHECK(other.size() == 5);
+    }
+
+    SECTION("with_lock returns the function's result") {
+        int total = queue.with_lock([](auto& view){
+            int sum = 0;
+            for (auto n = view.size(); n > 0; --n) {
+                sum += view.front();
+                view.push(view.front());
+                view.pop();
+            }
+            return sum;
+        });
+        CHECK(total == 10);
+        CHECK(queue.pop() == 0);
+        CHECK(queue.with_lock([](auto& view){ return view.size(); }) == 4);
+    }
+
+    SECTION("pushing through a view wakes up waiting threads") {
+        queue.clear();
+        int popped = 0;
+        std::thread consumer([&](){ popped = queue.pop(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.with_lock([](auto& view){ view.push(42); });
+        consumer.join();
+        CHECK(popped == 42);
+        CHECK(queue.with_lock([](auto& view){ return view.empty(); }));
+    }
+}
+
+TEST_CASE("Selector waits on several AtomicQueues at once", "[selector]") {
+    LCH::AtomicQueue<int> numbers;
+    LCH::AtomicQueue<std::string> words;
+
+    std::vector<int> gotNumbers;
+    std::vector<std::string> gotWords;
+    LCH::Selector selector;
+    REQUIRE(selector.add(numbers, [&](int n){ gotNumbers.push_back(n); }) == 0);
+    REQUIRE(selector.add(words, [&](std::string w){ gotWords.push_back(w); }) 
+            == 1);
+
+    SECTION("nothing ready") {
+        CHECK(selector.try_wait() == LCH::Selector::none);
+        CHECK(selector.wait_for(std::chrono::milliseconds(5)) 
+              == LCH::Selector::none);
+    }
+
+    SECTION("ready queues are handled in round-robin order") {
+        numbers.push(1);
+        numbers.push(2);
+        words.push("one");
+        CHECK(selector.wait() == 0);
+        CHECK(selector.wait() == 1);
+        CHECK(selector.wait() == 0);
+        CHECK(selector.try_wait() == LCH::Selector::none);
+        CHECK(gotNumbers == std::vector<int>{1, 2});
+        CHECK(gotWords == std::vector<std::string>{"one"});
+    }
+
+    SECTION("pushes from other threads wake up the selector") {
+        constexpr int count = 200;
+        std::thread numberProducer([&](){
+            for (int i = 0; i < count; ++i) numbers.push(i);
+        });
+        std::thread wordProducer([&](){
+            for (int i = 0; i < count; ++i) {
+                words.with_lock([i](auto& view){ 
+                    view.push(std::to_string(i)); 
+                });
+            }
+        });
+        for (int i = 0; i < 2*count; ++i) selector.wait();
+        numberProducer.join();
+        wordProducer.join();
+
+        REQUIRE(gotNumbers.size() == count);
+        REQUIRE(gotWords.size() == count);
+        for (int i = 0; i < count; ++i) {
+            CHECK(gotNumbers[i] == i);
+            CHECK(gotWords[i] == std::to_string(i));
+        }
+    }
+
+    SECTION("try_pop doesn't block") {
+        int value = -1;
+        CHECK(!numbers.try_pop(value));
+        numbers.push(7);
+        CHECK(numbers.try_pop(value));
+        CHECK(value == 7);
+    }
+}
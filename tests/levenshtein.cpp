@@ -18,6 +18,46 @@
 
 #include "Catch2/catch.hpp"
 
+#include <forward_list>
+#include <limits>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+// Straightforward full-matrix Levenshtein distance to check the library's
+// faster methods against.
+template<class SequenceA, class SequenceB>
+std::size_t NaiveDistance(const SequenceA& a, const SequenceB& b, 
+                          const LCH::LevenshteinCosts& costs = {}) {
+    std::vector<std::vector<std::size_t>> d(a.size() + 1, 
+            std::vector<std::size_t>(b.size() + 1));
+    for (std::size_t i = 0; i <= a.size(); ++i) d[i][0] = i*costs.del;
+    for (std::size_t j = 0; j <= b.size(); ++j) d[0][j] = j*costs.ins;
+    for (std::size_t i = 1; i <= a.size(); ++i) {
+        for (std::size_t j = 1; j <= b.size(); ++j) {
+            d[i][j] = std::min({
+                d[i-1][j-1] + (a[i-1] == b[j-1] ? 0 : costs.sub),
+                d[i][j-1] + costs.ins,
+                d[i-1][j] + costs.del});
+        }
+    }
+    return d[a.size()][b.size()];
+}
+
+// Random sequences over a small alphabet, so that they have plenty of matches.
+template<class Sequence>
+Sequence RandomSequence(std::mt19937& rng, std::size_t length, 
+                        int alphabetSize, int offset = 'a') {
+    std::uniform_int_distribution<int> symbol(0, alphabetSize - 1);
+    Sequence output;
+    for (std::size_t i = 0; i < length; ++i) {
+        output.push_back(
+                static_cast<typename Sequence::value_type>(offset + symbol(rng)));
+    }
+    return output;
+}
+
 static_assert(LCH::is_iterable<std::vector<int>>::value, "vector should be iterable");
 static_assert(LCH::is_iterable<const char*>::value, "const char* should be iterable");
 static_assert(!LCH::is_iterable<const int*>::value, "const int* should not be iterable");
@@ -98,3 +138,331 @@ TEST_CASE("Levenshtein distance works", "[levenshtein]") {
     CHECK(LCH::levenshtein_distance("", "") == 0);
     CHECK(LCH::levenshtein_distance("", "", costs) == 0);
 }
+
+TEST_CASE("bit-parallel Levenshtein distance matches the DP", 
+          "[levenshtein][bit_parallel]") {
+    std::mt19937 rng(26);
+    const std::vector<std::size_t> lengths{0, 1, 5, 63, 64, 65, 127, 128, 200};
+    const LCH::LevenshteinCosts threes{3, 3, 3};
+
+    SECTION("single-byte symbols") {
+        for (std::size_t lengthA : lengths) {
+            for (std::size_t lengthB : lengths) {
+                auto a = RandomSequence<std::string>(rng, lengthA, 4);
+                auto b = RandomSequence<std::string>(rng, lengthB, 4);
+                INFO(a << " vs " << b);
+                CHECK(LCH::levenshtein_distance(a, b) == NaiveDistance(a, b));
+                CHECK(LCH::levenshtein_distance(a, b, threes) 
+                      == 3*NaiveDistance(a, b));
+            }
+        }
+    }
+
+    SECTION("wider symbols and other iterators") {
+        for (std::size_t lengthA : lengths) {
+            for (std::size_t lengthB : lengths) {
+                auto a = RandomSequence<std::vector<int>>(rng, lengthA, 40, -20);
+                auto b = RandomSequence<std::vector<int>>(rng, lengthB, 40, -20);
+                std::list<int> listB(b.begin(), b.end());
+                CHECK(LCH::levenshtein_distance(a, listB) == NaiveDistance(a, b));
+
+                auto u32a = RandomSequence<std::u32string>(rng, lengthA, 5, 0x3042);
+                auto u32b = RandomSequence<std::u32string>(rng, lengthB, 5, 0x3042);
+                CHECK(LCH::levenshtein_distance(u32a, u32b) 
+                      == NaiveDistance(u32a, u32b));
+            }
+        }
+    }
+}
+
+TEST_CASE("anti-diagonal Levenshtein distance matches the DP", 
+          "[levenshtein][wavefront]") {
+    std::mt19937 rng(32);
+    const std::vector<std::size_t> lengths{24, 25, 40, 100, 257};
+    const std::vector<LCH::LevenshteinCosts> costModels{
+        {1, 5, 10}, {2, 1, 3}, {7, 4, 4}};
+    const std::vector<LCH::Detail::Simd> kernels{
+        LCH::Detail::Simd::none, LCH::Detail::Simd::sse41, 
+        LCH::Detail::Simd::avx2};
+
+    SECTION("through levenshtein_distance") {
+        for (const auto& costs : costModels) {
+            for (std::size_t lengthA : lengths) {
+                for (std::size_t lengthB : lengths) {
+                    auto a = RandomSequence<std::string>(rng, lengthA, 4);
+                    auto b = RandomSequence<std::string>(rng, lengthB, 4);
+                    CHECK(LCH::levenshtein_distance(a, b, costs) 
+                          == NaiveDistance(a, b, costs));
+
+                    auto wideA = RandomSequence<std::vector<long long>>(
+                            rng, lengthA, 6, -3);
+                    auto wideB = RandomSequence<std::vector<long long>>(
+                            rng, lengthB, 8, -3);
+                    CHECK(LCH::levenshtein_distance(wideA, wideB, costs) 
+                          == NaiveDistance(wideA, wideB, costs));
+                }
+            }
+        }
+    }
+
+    SECTION("each kernel and cell size") {
+        for (auto simd : kernels) {
+            if (simd == LCH::Detail::Simd::sse41 && !LCH::Cpu().sse41) continue;
+            if (simd == LCH::Detail::Simd::avx2 && !LCH::Cpu().avx2) continue;
+            for (std::size_t length : lengths) {
+                auto a = RandomSequence<std::u32string>(rng, length, 5, 0x3042);
+                auto b = RandomSequence<std::u32string>(rng, length + 3, 5, 
+                                                        0x3042);
+                for (const auto& costs : costModels) {
+                    std::size_t expected = NaiveDistance(a, b, costs);
+                    std::size_t narrow = 0;
+                    std::size_t wide = 0;
+                    REQUIRE(LCH::Detail::WavefrontDistanceWith<std::uint16_t>(
+                            a.begin(), a.end(), a.size(), b.begin(), b.end(), 
+                            b.size(), costs, simd, narrow));
+                    REQUIRE(LCH::Detail::WavefrontDistanceWith<std::uint32_t>(
+                            a.begin(), a.end(), a.size(), b.begin(), b.end(), 
+                            b.size(), costs, simd, wide));
+                    CHECK(narrow == expected);
+                    CHECK(wide == expected);
+                }
+            }
+        }
+    }
+
+    SECTION("costs too large for 16-bit cells") {
+        const LCH::LevenshteinCosts huge{1000, 700, 900};
+        auto a = RandomSequence<std::string>(rng, 120, 3);
+        auto b = RandomSequence<std::string>(rng, 90, 3);
+        std::size_t distance = 0;
+        CHECK(!LCH::Detail::WavefrontDistanceWith<std::uint16_t>(
+                a.begin(), a.end(), a.size(), b.begin(), b.end(), b.size(), 
+                huge, LCH::Detail::Simd::none, distance));
+        CHECK(LCH::levenshtein_distance(a, b, huge) 
+              == NaiveDistance(a, b, huge));
+    }
+}
+
+TEST_CASE("bounded Levenshtein distance is exact up to the bound", 
+          "[levenshtein][bounded]") {
+    std::mt19937 rng(33);
+    const std::vector<std::size_t> lengths{0, 1, 7, 30, 70, 150};
+    const std::vector<LCH::LevenshteinCosts> costModels{
+        {1, 1, 1}, {1, 5, 10}, {3, 1, 2}, {2, 0, 1}};
+    const std::vector<std::size_t> bounds{0, 1, 3, 10, 40, 1000};
+
+    SECTION("small examples") {
+        CHECK(LCH::levenshtein_distance_bounded("kitten", "sitting", 3) == 3);
+        CHECK(LCH::levenshtein_distance_bounded("kitten", "sitting", 2) == 3);
+        CHECK(LCH::levenshtein_distance_bounded("kitten", "kitten", 0) == 0);
+        CHECK(LCH::levenshtein_distance_bounded("a", "abcdef", 4) == 5);
+        CHECK(LCH::levenshtein_distance_bounded("", "", 0) == 0);
+        std::string a = "flaw";
+        std::vector<char> b{'l', 'a', 'w', 'n'};
+        CHECK(LCH::levenshtein_distance_bounded(a, b.begin(), b.end(), 2) == 2);
+        CHECK(LCH::levenshtein_distance_bounded(a.begin(), a.end(), b, 1) == 2);
+        CHECK(LCH::levenshtein_distance_bounded(
+                a, b, std::numeric_limits<std::size_t>::max()) == 2);
+    }
+
+    SECTION("random sequences") {
+        for (const auto& costs : costModels) {
+            for (std::size_t lengthA : lengths) {
+                for (std::size_t lengthB : lengths) {
+                    auto a = RandomSequence<std::string>(rng, lengthA, 3);
+                    auto b = RandomSequence<std::string>(rng, lengthB, 3);
+                    std::list<char> listB(b.begin(), b.end());
+                    std::size_t expected = NaiveDistance(a, b, costs);
+                    for (std::size_t maxDist : bounds) {
+                        std::size_t clipped = std::min(expected, maxDist + 1);
+                        INFO(a << " vs " << b << " within " << maxDist);
+                        CHECK(LCH::levenshtein_distance_bounded(
+                                a, b, maxDist, costs) == clipped);
+                        CHECK(LCH::levenshtein_distance_bounded(
+                                a, listB, maxDist, costs) == clipped);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Levenshtein distance uses cells wide enough for the costs", 
+          "[levenshtein][cells]") {
+    // Doubles aren't integral, so these always use the one-row method (or
+    // the banded one), with the narrowest cells that can hold the distance.
+    std::mt19937 rng(36);
+    const std::vector<LCH::LevenshteinCosts> costModels{
+        {1, 1, 1}, {2, 3, 1}, {100, 90, 80}, {1000, 3000, 2000}, 
+        {100000, 70000, 90000}};
+    for (const auto& costs : costModels) {
+        for (std::size_t length : {0, 1, 2, 3, 10, 40, 150}) {
+            auto a = RandomSequence<std::vector<double>>(rng, length, 3, 0);
+            auto b = RandomSequence<std::vector<double>>(rng, length/2 + 1, 
+                                                         3, 0);
+            std::size_t expected = NaiveDistance(a, b, costs);
+            INFO(length << " symbols, costs " << costs.sub << ", " 
+                 << costs.ins << ", " << costs.del);
+            CHECK(LCH::levenshtein_distance(a, b, costs) == expected);
+            CHECK(LCH::levenshtein_distance(b, a, costs) 
+                  == NaiveDistance(b, a, costs));
+            for (std::size_t maxDist : {expected/2, expected, std::size_t(250), 
+                                         std::size_t(60000)}) {
+                CHECK(LCH::levenshtein_distance_bounded(a, b, maxDist, costs)
+                      == std::min(expected, maxDist + 1));
+            }
+        }
+    }
+}
+
+TEST_CASE("Levenshtein distance skips common prefixes and suffixes", 
+          "[levenshtein][affixes]") {
+    const LCH::LevenshteinCosts costs{3, 2, 5};
+    const std::string path = "/usr/local/lib/libexample.so.";
+
+    CHECK(LCH::levenshtein_distance(path + "1.2.3", path + "1.2.4") == 1);
+    CHECK(LCH::levenshtein_distance(path + "1.2.3", path + "1.12.3") == 1);
+    CHECK(LCH::levenshtein_distance(path, path) == 0);
+    CHECK(LCH::levenshtein_distance(path, path, costs) == 0);
+    CHECK(LCH::levenshtein_distance(path + "x", path, costs) == 5);
+    CHECK(LCH::levenshtein_distance(path, "x" + path, costs) == 2);
+    CHECK(LCH::levenshtein_distance_bounded(path + "1.0", path + "2.0", 0) 
+          == 1);
+
+    // forward-only iterators only skip the prefix, but still get it right
+    std::forward_list<char> forward(path.begin(), path.end());
+    forward.push_front('v');
+    std::string other = "w" + path;
+    CHECK(LCH::levenshtein_distance(forward, other, costs) == 3);
+    CHECK(LCH::levenshtein_distance_bounded(forward, other, 2, costs) == 3);
+
+    // the ends can overlap when one side repeats
+    CHECK(LCH::levenshtein_distance("aaaa", "aaaaaa") == 2);
+    CHECK(LCH::levenshtein_distance("abab", "ab", costs) == 10);
+    CHECK(LCH::levenshtein_distance("ab", "abab", costs) == 4);
+}
+
+// Full-matrix optimal string alignment distance.
+template<class Sequence>
+std::size_t NaiveOSADistance(const Sequence& a, const Sequence& b, 
+                             const LCH::LevenshteinCosts& costs = {}) {
+    std::vector<std::vector<std::size_t>> d(a.size() + 1, 
+            std::vector<std::size_t>(b.size() + 1));
+    for (std::size_t i = 0; i <= a.size(); ++i) d[i][0] = i*costs.del;
+    for (std::size_t j = 0; j <= b.size(); ++j) d[0][j] = j*costs.ins;
+    for (std::size_t i = 1; i <= a.size(); ++i) {
+        for (std::size_t j = 1; j <= b.size(); ++j) {
+            d[i][j] = std::min({
+                d[i-1][j-1] + (a[i-1] == b[j-1] ? 0 : costs.sub),
+                d[i][j-1] + costs.ins,
+                d[i-1][j] + costs.del});
+            if (i > 1 && j > 1 && a[i-1] == b[j-2] && a[i-2] == b[j-1]) {
+                d[i][j] = std::min(d[i][j], d[i-2][j-2] + costs.trans);
+            }
+        }
+    }
+    return d[a.size()][b.size()];
+}
+
+// Unrestricted Damerau-Levenshtein distance by brute force: the cheapest
+// way to build b from a left to right, where each step either edits a symbol
+// or swaps the symbols at the ends of a stretch of a, deleting everything
+// between them, and inserts between the swapped symbols.
+template<class Sequence>
+std::size_t NaiveDamerauDistance(const Sequence& a, const Sequence& b, 
+                                 const LCH::LevenshteinCosts& costs = {}) {
+    std::vector<std::vector<std::size_t>> d(a.size() + 1, 
+            std::vector<std::size_t>(b.size() + 1));
+    for (std::size_t i = 0; i <= a.size(); ++i) d[i][0] = i*costs.del;
+    for (std::size_t j = 0; j <= b.size(); ++j) d[0][j] = j*costs.ins;
+    for (std::size_t i = 1; i <= a.size(); ++i) {
+        for (std::size_t j = 1; j <= b.size(); ++j) {
+            d[i][j] = std::min({
+                d[i-1][j-1] + (a[i-1] == b[j-1] ? 0 : costs.sub),
+                d[i][j-1] + costs.ins,
+                d[i-1][j] + costs.del});
+            // a[k] ... a[i-1] becomes b[l] ... b[j-1], with a[k] == b[j-1]
+            // and a[i-1] == b[l] swapped
+            for (std::size_t k = 0; k + 1 < i; ++k) {
+                for (std::size_t l = 0; l + 1 < j; ++l) {
+                    if (a[k] == b[j-1] && a[i-1] == b[l]) {
+                        d[i][j] = std::min(d[i][j], d[k][l] + costs.trans 
+                                + (i - k - 2)*costs.del 
+                                + (j - l - 2)*costs.ins);
+                    }
+                }
+            }
+        }
+    }
+    return d[a.size()][b.size()];
+}
+
+TEST_CASE("distances with transpositions", "[levenshtein][damerau]") {
+    SECTION("examples") {
+        CHECK(LCH::osa_distance("CA", "ABC") == 3);
+        CHECK(LCH::damerau_levenshtein_distance("CA", "ABC") == 2);
+        CHECK(LCH::levenshtein_distance("abcd", "acbd") == 2);
+        CHECK(LCH::osa_distance("abcd", "acbd") == 1);
+        CHECK(LCH::damerau_levenshtein_distance("abcd", "acbd") == 1);
+        const LCH::LevenshteinCosts costs{1, 1, 1, 5};
+        CHECK(LCH::osa_distance("abcd", "acbd", costs) == 2);
+        CHECK(LCH::osa_distance_bounded("teh cat", "the cta", 1) == 2);
+        CHECK(LCH::osa_distance_bounded("teh cat", "the cta", 2) == 2);
+        std::string a = "recieve";
+        std::list<char> b{'r', 'e', 'c', 'e', 'i', 'v', 'e'};
+        CHECK(LCH::osa_distance(a, b) == 1);
+        CHECK(LCH::osa_distance(a.begin(), a.end(), b) == 1);
+        CHECK(LCH::damerau_levenshtein_distance(a, b.begin(), b.end()) == 1);
+        // these can run out of memory, so they mustn't terminate if they do
+        CHECK(!noexcept(LCH::osa_distance(a, b)));
+        CHECK(!noexcept(LCH::damerau_levenshtein_distance(a, b)));
+    }
+
+    SECTION("costs too big for the usual cell bound") {
+        // the bound saturates, so the matrix's infinity is SIZE_MAX, and
+        // sums with it mustn't wrap around
+        const std::size_t c = std::numeric_limits<std::size_t>::max()/8;
+        const LCH::LevenshteinCosts huge{c, c, c, c};
+        for (auto pair : {std::make_pair("CA", "ABC"),
+                          std::make_pair("abcd", "acbd"),
+                          std::make_pair("ab", "ba"),
+                          std::make_pair("kitten", "sitting")}) {
+            INFO(pair.first << " vs " << pair.second);
+            CHECK(LCH::damerau_levenshtein_distance(pair.first, pair.second,
+                                                    huge)
+                  == c*LCH::damerau_levenshtein_distance(pair.first,
+                                                         pair.second));
+        }
+    }
+
+    SECTION("random sequences") {
+        std::mt19937 rng(38);
+        const std::vector<LCH::LevenshteinCosts> costModels{
+            {1, 1, 1, 1}, {2, 2, 2, 2}, {1, 1, 1, 2}, {3, 2, 4, 3}, 
+            {2, 3, 1, 2}};
+        const std::vector<std::size_t> lengths{0, 1, 2, 5, 12, 63, 64, 65, 
+                                               130};
+        for (const auto& costs : costModels) {
+            for (std::size_t lengthA : lengths) {
+                for (std::size_t lengthB : {lengthA, lengthA/2, lengthA + 3}) {
+                    auto a = RandomSequence<std::string>(rng, lengthA, 3);
+                    auto b = RandomSequence<std::string>(rng, lengthB, 3);
+                    INFO(a << " vs " << b << " with trans " << costs.trans);
+                    std::size_t osa = NaiveOSADistance(a, b, costs);
+                    CHECK(LCH::osa_distance(a, b, costs) == osa);
+                    CHECK(LCH::osa_distance_bounded(a, b, osa/2, costs) 
+                          == std::min(osa, osa/2 + 1));
+
+                    auto wideA = std::vector<int>(a.begin(), a.end());
+                    auto wideB = std::vector<double>(b.begin(), b.end());
+                    CHECK(LCH::osa_distance(wideA, wideB, costs) == osa);
+
+                    if (lengthA <= 20) {
+                        CHECK(LCH::damerau_levenshtein_distance(a, b, costs) 
+                              == NaiveDamerauDistance(a, b, costs));
+                    }
+                }
+            }
+        }
+    }
+}
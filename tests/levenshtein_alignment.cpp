@@ -0,0 +1,185 @@
+#include "levenshtein_alignment.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+std::string RandomAlignmentText(std::mt19937& rng, std::size_t length) {
+    std::uniform_int_distribution<int> letter('a', 'd');
+    std::string text;
+    for (std::size_t i = 0; i < length; ++i) text.push_back(letter(rng));
+    return text;
+}
+
+// A copy of text with roughly one edit in every tenth position.
+std::string MutatedText(std::mt19937& rng, const std::string& text) {
+    std::uniform_int_distribution<int> roll(0, 29);
+    std::uniform_int_distribution<int> letter('a', 'd');
+    std::string mutated;
+    for (char c : text) {
+        switch (roll(rng)) {
+          case 0: mutated.push_back(letter(rng)); break;
+          case 1: break;
+          case 2: mutated.push_back(letter(rng)); mutated.push_back(c); break;
+          default: mutated.push_back(c);
+        }
+    }
+    return mutated;
+}
+
+// Checks that edits are a valid script turning a into b (every position of
+// each visited in order, with matches only where the symbols are the same),
+// and returns its total cost.
+std::size_t ScriptCost(const std::string& a, const std::string& b,
+                       const std::vector<LCH::LevenshteinEdit>& edits,
+                       const LCH::LevenshteinCosts& costs) {
+    std::size_t i = 0;
+    std::size_t j = 0;
+    std::size_t cost = 0;
+    for (const auto& edit : edits) {
+        REQUIRE(edit.aIndex == i);
+        REQUIRE(edit.bIndex == j);
+        switch (edit.type) {
+          case LCH::EditType::match:
+            REQUIRE(i < a.size());
+            REQUIRE(j < b.size());
+            REQUIRE(a[i] == b[j]);
+            ++i, ++j;
+            break;
+          case LCH::EditType::sub:
+            REQUIRE(i < a.size());
+            REQUIRE(j < b.size());
+            cost += costs.sub;
+            ++i, ++j;
+            break;
+          case LCH::EditType::ins:
+            REQUIRE(j < b.size());
+            cost += costs.ins;
+            ++j;
+            break;
+          case LCH::EditType::del:
+            REQUIRE(i < a.size());
+            cost += costs.del;
+            ++i;
+            break;
+        }
+    }
+    REQUIRE(i == a.size());
+    REQUIRE(j == b.size());
+    return cost;
+}
+
+TEST_CASE("Levenshtein edit scripts", "[levenshtein][levenshtein_alignment]") {
+    std::mt19937 rng(39);
+    const std::vector<LCH::LevenshteinCosts> costModels{
+        {1, 1, 1}, {2, 1, 1}, {1, 3, 2}, {5, 2, 4}};
+
+    SECTION("simple examples") {
+        auto edits = LCH::levenshtein_edit_script(std::string("kitten"),
+                                                  std::string("sitting"));
+        REQUIRE(edits.size() == 7);
+        CHECK(edits[0].type == LCH::EditType::sub);
+        CHECK(edits[4].type == LCH::EditType::sub);
+        CHECK(edits[6].type == LCH::EditType::ins);
+        CHECK(edits[6].aIndex == 6);
+
+        CHECK(LCH::levenshtein_edit_script(std::string(),
+                                           std::string()).empty());
+        auto deletions = LCH::levenshtein_edit_script(std::string("abc"),
+                                                      std::string());
+        REQUIRE(deletions.size() == 3);
+        CHECK(deletions[2].type == LCH::EditType::del);
+        CHECK(deletions[2].aIndex == 2);
+        CHECK(deletions[2].bIndex == 0);
+    }
+
+    SECTION("small inputs") {
+        for (const auto& costs : costModels) {
+            for (int trial = 0; trial < 200; ++trial) {
+                auto a = RandomAlignmentText(rng, trial % 13);
+                auto b = RandomAlignmentText(rng, trial % 7);
+                auto edits = LCH::levenshtein_edit_script(a, b, costs);
+                INFO(a << " to " << b);
+                CHECK(ScriptCost(a, b, edits, costs)
+                      == LCH::levenshtein_distance(a, b, costs));
+            }
+        }
+    }
+
+    SECTION("inputs long enough to be split") {
+        LCH::ThreadPool pool(3);
+        for (const auto& costs : costModels) {
+            for (std::size_t length : {200, 900, 3000}) {
+                auto a = RandomAlignmentText(rng, length);
+                auto b = MutatedText(rng, a);
+                auto c = RandomAlignmentText(rng, length/3);
+                std::size_t distance = LCH::levenshtein_distance(a, b, costs);
+                std::size_t unrelated = LCH::levenshtein_distance(a, c, costs);
+                INFO(length);
+
+                auto edits = LCH::levenshtein_edit_script(a, b, costs);
+                CHECK(ScriptCost(a, b, edits, costs) == distance);
+                auto parallel = LCH::levenshtein_edit_script(a, b, costs,
+                                                             &pool);
+                CHECK(ScriptCost(a, b, parallel, costs) == distance);
+                auto other = LCH::levenshtein_edit_script(
+                        a.begin(), a.end(), c.begin(), c.end(), costs, &pool);
+                CHECK(ScriptCost(a, c, other, costs) == unrelated);
+            }
+        }
+    }
+
+    SECTION("a much shorter than b") {
+        // the rows run along the shorter input, whichever side it's on
+        LCH::ThreadPool pool(3);
+        for (const auto& costs : costModels) {
+            auto shortText = RandomAlignmentText(rng, 60);
+            auto longText = RandomAlignmentText(rng, 4000);
+            longText.replace(1000, 60, shortText);
+            for (bool swap : {false, true}) {
+                const auto& a = swap ? longText : shortText;
+                const auto& b = swap ? shortText : longText;
+                std::size_t distance = LCH::levenshtein_distance(a, b, costs);
+                INFO(swap);
+
+                auto edits = LCH::levenshtein_edit_script(a, b, costs);
+                CHECK(ScriptCost(a, b, edits, costs) == distance);
+                auto parallel = LCH::levenshtein_edit_script(a, b, costs,
+                                                             &pool);
+                CHECK(ScriptCost(a, b, parallel, costs) == distance);
+            }
+        }
+    }
+}
+
+TEST_CASE("Levenshtein edit scripts of other sequences",
+          "[levenshtein][levenshtein_alignment]") {
+    std::vector<std::string> before{"int", "main", "(", ")", "{", "}"};
+    std::vector<std::string> after{"int", "main", "(", "void", ")", "{", "}"};
+    auto edits = LCH::levenshtein_edit_script(before, after);
+    REQUIRE(edits.size() == 7);
+    CHECK(edits[3].type == LCH::EditType::ins);
+    CHECK(edits[3].aIndex == 3);
+    CHECK(edits[3].bIndex == 3);
+    for (std::size_t k : {0, 1, 2, 4, 5, 6}) {
+        CHECK(edits[k].type == LCH::EditType::match);
+    }
+}
@@ -0,0 +1,128 @@
+#include "levenshtein_index.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::vector<std::string> RandomVocabulary(std::mt19937& rng, std::size_t count) {
+    std::uniform_int_distribution<int> letter('a', 'f');
+    std::uniform_int_distribution<std::size_t> length(0, 10);
+    std::vector<std::string> words;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::string word;
+        for (std::size_t j = length(rng); j > 0; --j) {
+            word.push_back(letter(rng));
+        }
+        words.push_back(word);
+    }
+    return words;
+}
+
+bool SameResults(const std::vector<LCH::LevenshteinMatch>& x,
+                 const std::vector<LCH::LevenshteinMatch>& y) {
+    return std::equal(x.begin(), x.end(), y.begin(), y.end(),
+            [](const auto& m, const auto& n){
+                return m.index == n.index && m.distance == n.distance;
+            });
+}
+
+// What the index should find: a linear search, nearest first.
+std::vector<LCH::LevenshteinMatch> Expected(
+        const std::string& query, const std::vector<std::string>& vocabulary,
+        std::size_t maxDist, const LCH::LevenshteinCosts& costs = {}) {
+    auto expected = LCH::levenshtein_search(query, vocabulary, maxDist, costs);
+    std::sort(expected.begin(), expected.end(), LCH::Detail::CloserMatch);
+    return expected;
+}
+
+TEST_CASE("LevenshteinIndex finds the same terms as a linear search",
+          "[levenshtein][levenshtein_index]") {
+    std::mt19937 rng(35);
+    auto vocabulary = RandomVocabulary(rng, 2000);
+    vocabulary.push_back(vocabulary[5]); // duplicates are kept
+    const std::vector<std::string> queries{
+        "", "abc", "fedcba", vocabulary[5], vocabulary[99] + "ab"};
+
+    SECTION("unit costs") {
+        LCH::LevenshteinIndex<std::string> index(vocabulary);
+        REQUIRE(index.Size() == vocabulary.size());
+        CHECK(index[5] == vocabulary[5]);
+        for (const auto& query : queries) {
+            for (std::size_t maxDist : {0, 1, 3, 20}) {
+                INFO(query << " within " << maxDist);
+                CHECK(SameResults(index.Query(query, maxDist),
+                                  Expected(query, vocabulary, maxDist)));
+            }
+        }
+        CHECK(index.Query(vocabulary[5], 0).size() == 2);
+    }
+
+    SECTION("weighted costs") {
+        const LCH::LevenshteinCosts costs{3, 2, 2};
+        LCH::LevenshteinIndex<std::string> index(vocabulary.begin(),
+                                                 vocabulary.end(), costs);
+        for (const auto& query : queries) {
+            for (std::size_t maxDist : {0, 2, 5, 9}) {
+                INFO(query << " within " << maxDist);
+                CHECK(SameResults(index.Query(query, maxDist),
+                                  Expected(query, vocabulary, maxDist, costs)));
+            }
+        }
+    }
+
+    SECTION("concurrent queries") {
+        const LCH::LevenshteinIndex<std::string> index(vocabulary);
+        std::atomic<bool> wrong{false};
+        std::vector<std::thread> threads;
+        for (const auto& query : queries) {
+            threads.emplace_back([&, query](){
+                auto expected = Expected(query, vocabulary, 2);
+                for (int i = 0; i < 20; ++i) {
+                    if (!SameResults(index.Query(query, 2), expected)) {
+                        wrong = true;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        CHECK(!wrong);
+    }
+}
+
+TEST_CASE("LevenshteinIndex edge cases", "[levenshtein][levenshtein_index]") {
+    LCH::LevenshteinIndex<std::string> empty(std::vector<std::string>{});
+    CHECK(empty.Size() == 0);
+    CHECK(empty.Query("anything", 100).empty());
+
+    LCH::LevenshteinIndex<std::string> words({"book", "books", "cake", "boo"});
+    auto found = words.Query("boon", 1);
+    REQUIRE(found.size() == 2);
+    CHECK(words[found[0].index] == "book");
+    CHECK(words[found[1].index] == "boo");
+
+    REQUIRE_THROWS_AS(LCH::LevenshteinIndex<std::string>(
+                              std::vector<std::string>{"a"}, 
+                              LCH::LevenshteinCosts{1, 1, 2}),
+                      std::invalid_argument);
+}
@@ -0,0 +1,125 @@
+#include "levenshtein_matrix.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+// Enough words to need several tiles each way, some of them long.
+std::vector<std::string> RandomPairWords(std::mt19937& rng, std::size_t count) {
+    std::uniform_int_distribution<int> letter('a', 'e');
+    std::uniform_int_distribution<std::size_t> length(0, 15);
+    std::vector<std::string> words;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t size = i % 50 == 0 ? 300 : length(rng);
+        std::string word;
+        for (std::size_t j = 0; j < size; ++j) word.push_back(letter(rng));
+        words.push_back(word);
+    }
+    return words;
+}
+
+template<class Distance>
+bool MatchesDirectDistances(const LCH::Matrix<Distance>& matrix,
+                            const std::vector<std::string>& words,
+                            const LCH::LevenshteinCosts& costs) {
+    if (matrix.Rows() != words.size() || matrix.Cols() != words.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        for (std::size_t j = 0; j < words.size(); ++j) {
+            std::size_t expected = std::min<std::size_t>(
+                    LCH::levenshtein_distance(words[i], words[j], costs),
+                    std::numeric_limits<Distance>::max());
+            if (matrix(i, j) != expected) return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("all-pairs Levenshtein distances",
+          "[levenshtein][levenshtein_matrix]") {
+    std::mt19937 rng(41);
+    auto words = RandomPairWords(rng, 300);
+    LCH::ThreadPool pool(3);
+
+    SECTION("full matrices") {
+        const std::vector<LCH::LevenshteinCosts> costModels{
+            {1, 1, 1}, {1, 2, 2}, {2, 1, 3}};
+        for (const auto& costs : costModels) {
+            CHECK(MatchesDirectDistances(
+                    LCH::levenshtein_distance_matrix(words, costs), words,
+                    costs));
+            CHECK(MatchesDirectDistances(
+                    LCH::levenshtein_distance_matrix(words, costs, &pool),
+                    words, costs));
+        }
+    }
+
+    SECTION("distances too big for the element type are capped") {
+        auto narrow = LCH::levenshtein_distance_matrix<std::uint8_t>(
+                words, {1, 1, 1}, &pool);
+        CHECK(narrow(0, 1) == 255);
+        CHECK(MatchesDirectDistances(narrow, words, {1, 1, 1}));
+    }
+
+    SECTION("condensed distances") {
+        LCH::LevenshteinCosts costs{2, 3, 3};
+        auto condensed = LCH::levenshtein_condensed_distances(words, costs);
+        auto parallel = LCH::levenshtein_condensed_distances(words, costs,
+                                                             &pool);
+        REQUIRE(condensed.size() == words.size()*(words.size() - 1)/2);
+        CHECK(parallel == condensed);
+
+        bool allMatch = true;
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            for (std::size_t j = i + 1; j < words.size(); ++j, ++k) {
+                allMatch = allMatch && LCH::condensed_index(words.size(), i, j)
+                                       == k
+                           && condensed[k] == LCH::levenshtein_distance(
+                                                  words[i], words[j], costs);
+            }
+        }
+        CHECK(allMatch);
+
+        CHECK_THROWS_AS(LCH::levenshtein_condensed_distances(words, {1, 1, 2}),
+                        std::invalid_argument);
+    }
+
+    SECTION("tiny inputs") {
+        std::vector<std::string> none;
+        CHECK(LCH::levenshtein_condensed_distances(none).empty());
+        CHECK(LCH::levenshtein_distance_matrix(none).Rows() == 0);
+
+        const char* three[] = {"cat", "cart", "dog"};
+        auto matrix = LCH::levenshtein_distance_matrix(three);
+        CHECK(matrix(0, 1) == 1);
+        CHECK(matrix(1, 0) == 1);
+        CHECK(matrix(2, 1) == 4);
+        CHECK(matrix(2, 2) == 0);
+        CHECK(LCH::levenshtein_condensed_distances(three)
+              == std::vector<std::uint16_t>{1, 3, 4});
+    }
+}
@@ -0,0 +1,131 @@
+#include "levenshtein_search.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// A dictionary of words over a small alphabet with a wide range of lengths,
+// including some long enough to need several words of bit masks.
+std::vector<std::string> RandomDictionary(std::mt19937& rng, std::size_t count) {
+    std::uniform_int_distribution<int> letter('a', 'd');
+    std::uniform_int_distribution<std::size_t> shortLength(0, 12);
+    std::uniform_int_distribution<std::size_t> longLength(60, 140);
+    std::vector<std::string> words;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t length = i % 10 == 0 ? longLength(rng) : shortLength(rng);
+        std::string word;
+        for (std::size_t j = 0; j < length; ++j) word.push_back(letter(rng));
+        words.push_back(word);
+    }
+    return words;
+}
+
+template<class Candidates>
+std::vector<LCH::LevenshteinMatch> AllDistances(
+        const std::string& query, const Candidates& candidates,
+        const LCH::LevenshteinCosts& costs) {
+    std::vector<LCH::LevenshteinMatch> all;
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        all.push_back({i, LCH::levenshtein_distance(query, candidates[i],
+                                                    costs)});
+    }
+    return all;
+}
+
+bool SameMatches(const std::vector<LCH::LevenshteinMatch>& x,
+                 const std::vector<LCH::LevenshteinMatch>& y) {
+    return std::equal(x.begin(), x.end(), y.begin(), y.end(),
+            [](const auto& m, const auto& n){
+                return m.index == n.index && m.distance == n.distance;
+            });
+}
+
+TEST_CASE("one-to-many Levenshtein search agrees with one-to-one distances",
+          "[levenshtein][levenshtein_search]") {
+    std::mt19937 rng(34);
+    auto dictionary = RandomDictionary(rng, 3000);
+    const std::vector<std::string> queries{
+        "", "abc", "abcdabcd", dictionary[10], dictionary[11] + "xyz"};
+    const std::vector<LCH::LevenshteinCosts> costModels{
+        {1, 1, 1}, {2, 2, 2}, {1, 3, 2}};
+    LCH::ThreadPool pool(3);
+
+    SECTION("within a threshold") {
+        for (const auto& costs : costModels) {
+            for (const auto& query : queries) {
+                auto all = AllDistances(query, dictionary, costs);
+                for (std::size_t maxDist : {0, 2, 5, 30}) {
+                    INFO(query << " within " << maxDist);
+                    std::vector<LCH::LevenshteinMatch> expected;
+                    std::copy_if(all.begin(), all.end(),
+                                 std::back_inserter(expected),
+                                 [=](const auto& m){
+                                     return m.distance <= maxDist;
+                                 });
+                    CHECK(SameMatches(LCH::levenshtein_search(
+                            query, dictionary, maxDist, costs), expected));
+                    CHECK(SameMatches(LCH::levenshtein_search(
+                            query, dictionary, maxDist, costs, &pool),
+                            expected));
+                }
+            }
+        }
+    }
+
+    SECTION("k nearest") {
+        for (const auto& costs : costModels) {
+            for (const auto& query : queries) {
+                auto all = AllDistances(query, dictionary, costs);
+                std::sort(all.begin(), all.end(), LCH::Detail::CloserMatch);
+                for (std::size_t k : {0, 1, 10, 500}) {
+                    INFO(query << " nearest " << k);
+                    std::vector<LCH::LevenshteinMatch> expected(
+                            all.begin(), all.begin() + k);
+                    CHECK(SameMatches(LCH::levenshtein_nearest(
+                            query, dictionary, k, costs), expected));
+                    CHECK(SameMatches(LCH::levenshtein_nearest(
+                            query, dictionary, k, costs, &pool), expected));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Levenshtein search takes other kinds of candidates",
+          "[levenshtein][levenshtein_search]") {
+    const char* words[] = {"apple", "apply", "ample", "maple", "apples"};
+
+    auto close = LCH::levenshtein_search("appel", words, 2);
+    REQUIRE(close.size() == 3);
+    CHECK(close[0].index == 0);
+    CHECK(close[1].index == 1);
+    CHECK(close[2].index == 4);
+    CHECK(close[2].distance == 2);
+
+    std::vector<std::u32string> wide{U"ことば", U"こども", U"ことり"};
+    auto nearest = LCH::levenshtein_nearest(std::u32string(U"ことぱ"), wide, 2);
+    REQUIRE(nearest.size() == 2);
+    CHECK(nearest[0].index == 0);
+    CHECK(nearest[0].distance == 1);
+    CHECK(nearest[1].index == 2);
+    CHECK(nearest[1].distance == 1);
+}
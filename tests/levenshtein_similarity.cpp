@@ -0,0 +1,147 @@
+#include "levenshtein_similarity.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+std::string RandomSimilarWord(std::mt19937& rng, std::size_t maxLength) {
+    std::uniform_int_distribution<int> letter('a', 'f');
+    std::uniform_int_distribution<std::size_t> length(0, maxLength);
+    std::string word;
+    for (std::size_t n = length(rng); n > 0; --n) word.push_back(letter(rng));
+    return word;
+}
+
+TEST_CASE("Levenshtein lower bounds and similarities",
+          "[levenshtein][levenshtein_similarity]") {
+    const std::vector<LCH::LevenshteinCosts> costModels{
+        {1, 1, 1}, {2, 1, 1}, {1, 3, 2}, {5, 2, 1}};
+
+    SECTION("lower bounds") {
+        CHECK(LCH::levenshtein_lower_bound("abc", "cab") == 0);
+        CHECK(LCH::levenshtein_lower_bound("aaaa", "bb") == 4);
+        CHECK(LCH::levenshtein_lower_bound("aaaa", "bb", {1, 5, 5}) == 12);
+        CHECK(LCH::levenshtein_lower_bound("aaaa", "bb", {9, 1, 1}) == 6);
+        std::vector<std::string> words{"one", "two"};
+        std::vector<std::string> others{"two", "one", "three"};
+        CHECK(LCH::levenshtein_lower_bound(words, others) == 1);
+
+        std::mt19937 rng(42);
+        bool neverAbove = true;
+        bool sometimesExact = false;
+        for (const auto& costs : costModels) {
+            for (int trial = 0; trial < 1000; ++trial) {
+                auto a = RandomSimilarWord(rng, 20);
+                auto b = RandomSimilarWord(rng, 20);
+                std::size_t bound = LCH::levenshtein_lower_bound(a, b, costs);
+                std::size_t distance = LCH::levenshtein_distance(a, b, costs);
+                neverAbove = neverAbove && bound <= distance;
+                sometimesExact = sometimesExact
+                                 || (bound == distance && distance > 0);
+                std::u32string wideA(a.begin(), a.end());
+                std::u32string wideB(b.begin(), b.end());
+                wideB += U'\x3100';
+                neverAbove = neverAbove
+                             && LCH::levenshtein_lower_bound(wideA, wideB,
+                                                             costs)
+                                <= LCH::levenshtein_distance(wideA, wideB,
+                                                             costs);
+            }
+        }
+        CHECK(neverAbove);
+        CHECK(sometimesExact);
+    }
+
+    SECTION("normalized similarity") {
+        CHECK(LCH::levenshtein_similarity("", "") == 1.0);
+        CHECK(LCH::levenshtein_similarity("abc", "abc") == 1.0);
+        CHECK(LCH::levenshtein_similarity("abc", "") == 0.0);
+        CHECK(LCH::levenshtein_similarity("abc", "xyz") == 0.0);
+        CHECK(LCH::levenshtein_similarity("kitten", "sitting")
+              == Approx(1 - 3.0/7));
+        // the worst case is deleting both and inserting four
+        CHECK(LCH::levenshtein_similarity("ab", "abcd", {5, 1, 1})
+              == Approx(1 - 2.0/6));
+
+        std::mt19937 rng(420);
+        bool consistent = true;
+        for (const auto& costs : costModels) {
+            for (int trial = 0; trial < 1000; ++trial) {
+                auto a = RandomSimilarWord(rng, 12);
+                auto b = RandomSimilarWord(rng, 12);
+                double similarity = LCH::levenshtein_similarity(a, b, costs);
+                consistent = consistent && similarity >= 0 && similarity <= 1;
+                for (double min : {0.0, 0.25, 0.5, 0.8, 1.0}) {
+                    double bounded = LCH::levenshtein_similarity_bounded(
+                            a, b, min, costs);
+                    consistent = consistent
+                                 && bounded == (similarity >= min ? similarity
+                                                                  : 0.0);
+                }
+            }
+        }
+        CHECK(consistent);
+        CHECK(LCH::levenshtein_similarity_bounded("abcde", "abcdx", 0.8)
+              == Approx(0.8));
+        CHECK(LCH::levenshtein_similarity_bounded("abcde", "abcxx", 0.8)
+              == 0.0);
+    }
+
+    SECTION("Jaro and Jaro-Winkler") {
+        CHECK(LCH::jaro_similarity("MARTHA", "MARHTA") == Approx(0.944444));
+        CHECK(LCH::jaro_winkler_similarity("MARTHA", "MARHTA")
+              == Approx(0.961111));
+        CHECK(LCH::jaro_similarity("DWAYNE", "DUANE") == Approx(0.822222));
+        CHECK(LCH::jaro_winkler_similarity("DWAYNE", "DUANE")
+              == Approx(0.84));
+        CHECK(LCH::jaro_similarity("DIXON", "DICKSONX") == Approx(0.766667));
+        CHECK(LCH::jaro_winkler_similarity("DIXON", "DICKSONX")
+              == Approx(0.813333));
+        CHECK(LCH::jaro_winkler_similarity("", "") == 1.0);
+        CHECK(LCH::jaro_winkler_similarity("abc", "") == 0.0);
+        CHECK(LCH::jaro_winkler_similarity("abc", "xyz") == 0.0);
+        // below the threshold for the prefix bonus
+        CHECK(LCH::jaro_winkler_similarity("abcdef", "abxyzw")
+              == LCH::jaro_similarity("abcdef", "abxyzw"));
+        std::string martha("MARTHA");
+        CHECK(LCH::jaro_winkler_similarity(martha.begin(), martha.end(),
+                                           martha.begin(), martha.end())
+              == 1.0);
+
+        std::mt19937 rng(4200);
+        bool consistent = true;
+        for (int trial = 0; trial < 3000; ++trial) {
+            auto a = RandomSimilarWord(rng, 15);
+            auto b = RandomSimilarWord(rng, 15);
+            double similarity = LCH::jaro_winkler_similarity(a, b);
+            consistent = consistent && similarity >= 0 && similarity <= 1
+                         && LCH::jaro_similarity(a, b) <= similarity;
+            for (double min : {0.5, 0.7, 0.9}) {
+                double bounded = LCH::jaro_winkler_similarity_bounded(a, b,
+                                                                      min);
+                consistent = consistent
+                             && bounded == (similarity >= min ? similarity
+                                                              : 0.0);
+            }
+        }
+        CHECK(consistent);
+    }
+}
@@ -0,0 +1,129 @@
+#include "levenshtein_utf8.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+std::string EncodeUTF8(const std::u32string& text) {
+    std::string encoded;
+    for (char32_t c : text) {
+        if (c < 0x80) {
+            encoded.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            encoded.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            encoded.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            encoded.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            encoded.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            encoded.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            encoded.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            encoded.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            encoded.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            encoded.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+    return encoded;
+}
+
+// Text drawn from a few symbols of each encoded length, chosen so that many of
+// them share leading bytes: a, b, é, è, あ, い, ア, and two emoji.
+std::u32string RandomMixedText(std::mt19937& rng, std::size_t length) {
+    const char32_t symbols[] = {U'a', U'b', 0xE9, 0xE8, 0x3042, 0x3044, 0x30A2,
+                                0x1F600, 0x1F601};
+    std::uniform_int_distribution<std::size_t> pick(0, std::size(symbols) - 1);
+    std::u32string text;
+    for (std::size_t i = 0; i < length; ++i) text.push_back(symbols[pick(rng)]);
+    return text;
+}
+
+TEST_CASE("UTF-8 Levenshtein distance counts code points",
+          "[levenshtein][levenshtein_utf8]") {
+    SECTION("examples") {
+        // two kana added, not six bytes
+        CHECK(LCH::utf8_levenshtein_distance("ひらがな", "ひらがなです") == 2);
+        CHECK(LCH::levenshtein_distance("ひらがな", "ひらがなです") == 6);
+        CHECK(LCH::utf8_levenshtein_distance("ひらがな", "ひらかな") == 1);
+        CHECK(LCH::utf8_levenshtein_distance("あ", "ア") == 1);
+        CHECK(LCH::utf8_levenshtein_distance("日本語", "") == 3);
+        CHECK(LCH::utf8_levenshtein_distance("", "日本語です") == 5);
+        CHECK(LCH::utf8_levenshtein_distance("kitten", "sitting") == 3);
+        CHECK(LCH::utf8_levenshtein_distance("naïve café", "naive cafe") == 2);
+        CHECK(LCH::utf8_levenshtein_distance("東京都", "東京都") == 0);
+        CHECK(LCH::utf8_levenshtein_distance("東京都", "京都府",
+                                             {1, 2, 3}) == 3);
+        CHECK(LCH::utf8_levenshtein_distance_bounded("ひらがな", "ひ", 2)
+              == 3);
+        CHECK(LCH::utf8_levenshtein_distance_bounded("ひらがな", "ひら", 2)
+              == 2);
+    }
+
+    SECTION("agrees with distances between decoded strings") {
+        std::mt19937 rng(40);
+        const std::vector<LCH::LevenshteinCosts> costModels{
+            {1, 1, 1}, {2, 1, 3}};
+        for (const auto& costs : costModels) {
+            for (int trial = 0; trial < 300; ++trial) {
+                auto a = RandomMixedText(rng, trial % 17);
+                auto b = trial % 3 == 0 ? a + RandomMixedText(rng, 2)
+                                        : RandomMixedText(rng, trial % 11);
+                if (trial % 5 == 0) b = RandomMixedText(rng, 2) + a;
+                if (trial % 7 == 0 && !b.empty()) b[b.size()/2] = U'a';
+                std::string a8 = EncodeUTF8(a);
+                std::string b8 = EncodeUTF8(b);
+                INFO(a8 << " to " << b8);
+                std::size_t expected = LCH::levenshtein_distance(a, b, costs);
+                CHECK(LCH::utf8_levenshtein_distance(a8, b8, costs)
+                      == expected);
+                CHECK(LCH::utf8_levenshtein_distance_bounded(a8, b8, 4, costs)
+                      == std::min(expected, std::size_t(5)));
+            }
+        }
+    }
+
+    SECTION("long inputs") {
+        std::mt19937 rng(400);
+        auto a = RandomMixedText(rng, 1000);
+        auto b = a;
+        b[100] = U'b';
+        b.insert(500, U"アイ");
+        b.erase(900, 3);
+        std::size_t expected = LCH::levenshtein_distance(a, b);
+        CHECK(expected <= 6);
+        CHECK(LCH::utf8_levenshtein_distance(EncodeUTF8(a), EncodeUTF8(b))
+              == expected);
+    }
+
+    SECTION("invalid bytes are symbols of their own") {
+        const std::string lone("\x80");
+        const std::string truncated("\xE3\x81");
+        const std::string overlong("\xC0\xAF");
+        const std::string surrogate("\xED\xA0\x80");
+        CHECK(LCH::utf8_levenshtein_distance(lone, "") == 1);
+        CHECK(LCH::utf8_levenshtein_distance(truncated, "あ") == 2);
+        CHECK(LCH::utf8_levenshtein_distance("x" + truncated + "y",
+                                             "x" + truncated + "z") == 1);
+        CHECK(LCH::utf8_levenshtein_distance(overlong, "/") == 2);
+        CHECK(LCH::utf8_levenshtein_distance(surrogate, "") == 3);
+        CHECK(LCH::utf8_levenshtein_distance(lone, "\x81") == 1);
+        CHECK(LCH::utf8_levenshtein_distance(lone, "\xC2\x80") == 1);
+    }
+}
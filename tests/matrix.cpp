@@ -0,0 +1,517 @@
+#include "matrix.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2020 by Charles Hussong                                         //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+template<class T>
+LCH::Matrix<T> RandomMatrix(std::mt19937& rng, std::size_t rows,
+                            std::size_t cols) {
+    std::uniform_int_distribution<int> value(-8, 8);
+    LCH::Matrix<T> matrix(rows, cols);
+    for (std::size_t i = 0; i < rows; ++i) {
+        for (std::size_t j = 0; j < cols; ++j) {
+            matrix(i, j) = static_cast<T>(value(rng))/T(4);
+        }
+    }
+    return matrix;
+}
+
+template<class T>
+LCH::Matrix<T> NaiveProduct(const LCH::Matrix<T>& a,
+                            const LCH::Matrix<T>& b) {
+    LCH::Matrix<T> product(a.Rows(), b.Cols());
+    for (std::size_t i = 0; i < a.Rows(); ++i) {
+        for (std::size_t j = 0; j < b.Cols(); ++j) {
+            T sum = 0;
+            for (std::size_t k = 0; k < a.Cols(); ++k) sum += a(i, k)*b(k, j);
+            product(i, j) = sum;
+        }
+    }
+    return product;
+}
+
+// The inputs are multiples of 1/4 with small numerators, so every product and
+// partial sum is exact in float and double and the order of summation doesn't
+// matter.
+template<class T>
+bool SameMatrix(const LCH::Matrix<T>& x, const LCH::Matrix<T>& y) {
+    if (x.Rows() != y.Rows() || x.Cols() != y.Cols()) return false;
+    for (std::size_t i = 0; i < x.Rows(); ++i) {
+        for (std::size_t j = 0; j < x.Cols(); ++j) {
+            if (x(i, j) != y(i, j)) return false;
+        }
+    }
+    return true;
+}
+
+// Sizes around and across the block boundaries.
+const std::size_t multiplySizes[][3] = {
+    {1, 1, 1}, {2, 3, 4}, {6, 16, 8}, {7, 17, 9}, {13, 1, 40}, {1, 300, 1},
+    {73, 33, 257}, {150, 70, 600}, {5, 2100, 3}};
+
+template<class TestType>
+void CheckMultiplication() {
+    std::mt19937 rng(44);
+
+    SECTION("operator* agrees with the naive product") {
+        for (const auto& size : multiplySizes) {
+            auto a = RandomMatrix<TestType>(rng, size[0], size[2]);
+            auto b = RandomMatrix<TestType>(rng, size[2], size[1]);
+            INFO(size[0] << "x" << size[2] << " times " << size[2] << "x"
+                 << size[1]);
+            CHECK(SameMatrix(a*b, NaiveProduct(a, b)));
+        }
+    }
+
+    SECTION("the portable kernel agrees too") {
+        for (const auto& size : multiplySizes) {
+            auto a = RandomMatrix<TestType>(rng, size[0], size[2]);
+            auto b = RandomMatrix<TestType>(rng, size[2], size[1]);
+            LCH::Matrix<TestType> c(size[0], size[1]);
+            LCH::Detail::BlockedGemm(size[0], size[1], size[2], TestType(1),
+                    a.Data(), size[2], b.Data(), size[1], c.Data(), size[1],
+                    LCH::Detail::MicroKernel<TestType>);
+            CHECK(SameMatrix(c, NaiveProduct(a, b)));
+        }
+    }
+
+    SECTION("Gemm scales and accumulates") {
+        auto a = RandomMatrix<TestType>(rng, 20, 30);
+        auto b = RandomMatrix<TestType>(rng, 30, 25);
+        auto c = RandomMatrix<TestType>(rng, 20, 25);
+        auto expected = NaiveProduct(a, b);
+        for (std::size_t i = 0; i < 20; ++i) {
+            for (std::size_t j = 0; j < 25; ++j) {
+                expected(i, j) = 2*expected(i, j) + 3*c(i, j);
+            }
+        }
+        LCH::Gemm(TestType(2), a, b, TestType(3), c);
+        CHECK(SameMatrix(c, expected));
+    }
+
+    SECTION("dimensions have to match") {
+        auto a = RandomMatrix<TestType>(rng, 3, 4);
+        auto b = RandomMatrix<TestType>(rng, 3, 4);
+        auto c = RandomMatrix<TestType>(rng, 4, 4);
+        auto d = RandomMatrix<TestType>(rng, 4, 3);
+        CHECK_THROWS_AS(a*b, std::invalid_argument);
+        CHECK_THROWS_AS(LCH::Gemm(TestType(1), a, c, TestType(0), d),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(LCH::Gemm(TestType(1), c, c, TestType(0), c),
+                        std::invalid_argument);
+    }
+}
+
+TEST_CASE("Matrix multiplication", "[matrix]") {
+    SECTION("float") { CheckMultiplication<float>(); }
+    SECTION("double") { CheckMultiplication<double>(); }
+    SECTION("int") { CheckMultiplication<int>(); }
+}
+
+TEST_CASE("Gemm with beta 0 ignores what was in c", "[matrix]") {
+    LCH::Matrix<double> a(2, 2);
+    a(0, 0) = a(1, 1) = 1;
+    LCH::Matrix<double> c(2, 2);
+    c(0, 1) = std::nan("");
+    LCH::Gemm(1.0, a, a, 0.0, c);
+    CHECK(c(0, 0) == 1);
+    CHECK(c(0, 1) == 0);
+}
+
+TEST_CASE("Matrix element and row access", "[matrix]") {
+    LCH::Matrix<int> matrix(3, 4);
+    for (std::size_t i = 0; i < 3; ++i) {
+        for (std::size_t j = 0; j < 4; ++j) matrix(i, j) = int(10*i + j);
+    }
+    const auto& constMatrix = matrix;
+
+    SECTION("unchecked access sees the same elements") {
+        CHECK(matrix.Unchecked(2, 3) == 23);
+        CHECK(constMatrix.Unchecked(1, 0) == 10);
+        matrix.Unchecked(1, 2) = -1;
+        CHECK(matrix(1, 2) == -1);
+        CHECK(matrix.Row(2)[1] == 21);
+        CHECK(constMatrix.Row(1) == constMatrix.Data() + 4);
+        CHECK(matrix.Data()[11] == 23);
+        CHECK_THROWS_AS(matrix(3, 0), std::out_of_range);
+    }
+
+    SECTION("iterating over rows") {
+        std::vector<int> sums;
+        for (auto row : constMatrix) {
+            REQUIRE(row.size() == 4);
+            sums.push_back(std::accumulate(row.begin(), row.end(), 0));
+        }
+        CHECK(sums == std::vector<int>{6, 46, 86});
+
+        for (auto row : matrix) {
+            for (int& x : row) x *= 2;
+        }
+        CHECK(matrix(2, 3) == 46);
+
+        auto first = matrix.begin();
+        CHECK(std::distance(first, matrix.end()) == 3);
+        CHECK((*(first + 2))[0] == 40);
+        CHECK(first[1][1] == 22);
+        CHECK((*--matrix.end())[3] == 46);
+        CHECK(matrix.cbegin() < matrix.cend());
+    }
+
+    SECTION("empty matrices have no rows") {
+        LCH::Matrix<int> empty(0, 5);
+        CHECK(empty.begin() == empty.end());
+        LCH::Matrix<int> thin(3, 0);
+        CHECK(std::distance(thin.begin(), thin.end()) == 3);
+        CHECK((*thin.begin()).size() == 0);
+    }
+}
+
+TEST_CASE("Element-wise Matrix expressions", "[matrix]") {
+    std::mt19937 rng(46);
+    auto a = RandomMatrix<double>(rng, 7, 5);
+    auto b = RandomMatrix<double>(rng, 7, 5);
+    auto c = RandomMatrix<double>(rng, 7, 5);
+
+    SECTION("whole expressions are evaluated at once") {
+        auto expression = a*2.0 + b - c;
+        static_assert(!std::is_same_v<decltype(expression),
+                                      LCH::Matrix<double>>);
+        LCH::Matrix<double> d = expression;
+        LCH::Matrix<double> e = -(0.5*a) / 4.0
+                                + LCH::ElementwiseProduct(b, c - a);
+        LCH::Matrix<double> f = LCH::Apply(a - b, [](double x){
+            return x < 0 ? -x : x;
+        });
+        bool allMatch = true;
+        for (std::size_t i = 0; i < 7; ++i) {
+            for (std::size_t j = 0; j < 5; ++j) {
+                allMatch = allMatch
+                    && d(i, j) == a(i, j)*2 + b(i, j) - c(i, j)
+                    && e(i, j) == -(0.5*a(i, j))/4 + b(i, j)*(c(i, j) - a(i, j))
+                    && f(i, j) == std::abs(a(i, j) - b(i, j));
+            }
+        }
+        CHECK(allMatch);
+    }
+
+    SECTION("assignment reuses the target, which may be an operand") {
+        auto expected = a;
+        for (std::size_t i = 0; i < 7; ++i) {
+            for (std::size_t j = 0; j < 5; ++j) {
+                expected(i, j) = (3*a(i, j) - b(i, j))/2;
+            }
+        }
+        const double* storage = a.Data();
+        a = a + a;
+        a += a;
+        a -= a/4.0;
+        a -= b;
+        a /= 2.0;
+        CHECK(a.Data() == storage);
+        CHECK(SameMatrix(a, expected));
+
+        LCH::Matrix<double> ones(7, 5);
+        ones = LCH::ElementwiseQuotient(b, b) + c*0.0;
+        CHECK(ones(6, 4) == 1.0);
+    }
+
+    SECTION("expressions work with matrix products and other types") {
+        auto square = RandomMatrix<double>(rng, 5, 5);
+        CHECK(SameMatrix((a + b)*square, NaiveProduct(
+                LCH::Matrix<double>(a + b), square)));
+        LCH::Matrix<int> counts(2, 2);
+        counts(0, 1) = 3;
+        counts *= 2;
+        LCH::Matrix<int> shifted = counts - counts/2 + counts;
+        CHECK(shifted(0, 1) == 9);
+    }
+
+    SECTION("dimensions have to match") {
+        auto tall = RandomMatrix<double>(rng, 5, 7);
+        CHECK_THROWS_AS(a + tall, std::invalid_argument);
+        CHECK_THROWS_AS(LCH::ElementwiseProduct(a*2.0, tall),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(tall = a*2.0, std::invalid_argument);
+        CHECK_THROWS_AS(tall = a, std::invalid_argument);
+        CHECK_THROWS_AS(tall += a, std::invalid_argument);
+    }
+}
+
+TEST_CASE("Fixed-size matrices", "[matrix]") {
+    using Matrix3 = LCH::Matrix<double, 3, 3>;
+    constexpr Matrix3 shear{{1, 2, 0,
+                             0, 1, 0,
+                             0, 0, 1}};
+    constexpr LCH::Matrix<double, 3, 1> point{{1, 2, 3}};
+
+    SECTION("everything is computed at compile time") {
+        constexpr auto moved = shear*point;
+        static_assert(moved(0, 0) == 5 && moved(1, 0) == 2
+                      && moved(2, 0) == 3);
+        static_assert(shear*Matrix3::Identity() == shear);
+        static_assert((shear + shear)/2.0 - shear == Matrix3());
+        static_assert(-(2.0*shear)(0, 1) == -4);
+        static_assert(shear.Transposed()(1, 0) == 2);
+        static_assert(Matrix3::Rows() == 3 && sizeof(Matrix3)
+                                              == 9*sizeof(double));
+        constexpr LCH::Matrix<int, 2, 3> wide{{1, 2, 3, 4, 5, 6}};
+        constexpr LCH::Matrix<int, 2, 2> square = wide*wide.Transposed();
+        static_assert(square(0, 0) == 14 && square(0, 1) == 32
+                      && square(1, 1) == 77);
+        CHECK(square(1, 0) == 32);
+    }
+
+    SECTION("the same as dynamic matrices") {
+        std::mt19937 rng(47);
+        LCH::Matrix<double> a = RandomMatrix<double>(rng, 4, 3);
+        LCH::Matrix<double> b = RandomMatrix<double>(rng, 3, 2);
+        LCH::Matrix<double, 4, 3> fixedA(a);
+        LCH::Matrix<double, 3, 2> fixedB(b);
+        CHECK(SameMatrix(LCH::Matrix<double>(fixedA*fixedB), a*b));
+
+        fixedA += fixedA;
+        fixedA *= 0.5;
+        fixedA -= LCH::Matrix<double, 4, 3>(a);
+        CHECK(fixedA == LCH::Matrix<double, 4, 3>());
+        fixedA(3, 2) = 7;
+        CHECK(fixedA.Unchecked(3, 2) == 7);
+        CHECK(fixedA.Row(3)[2] == 7);
+        CHECK((*(fixedA.begin() + 3))[2] == 7);
+        CHECK(std::distance(fixedA.begin(), fixedA.end()) == 4);
+        CHECK_THROWS_AS(fixedA(4, 0), std::out_of_range);
+        CHECK_THROWS_AS((LCH::Matrix<double, 3, 4>(a)),
+                        std::invalid_argument);
+
+        std::ostringstream os;
+        os << LCH::Matrix<int, 2, 2>::Identity();
+        CHECK(os.str() == "1 0\n0 1");
+    }
+}
+
+// Writes contents to a file in the temporary directory and returns its path.
+LCH::File::path MatrixTextFile(const std::string& name,
+                               const std::string& contents) {
+    auto path = LCH::File::temp_directory_path() / name;
+    std::ofstream(path.native(), std::ios::binary) << contents;
+    return path;
+}
+
+TEST_CASE("Reading matrices from text files", "[matrix]") {
+    SECTION("elements, separators, and blank lines") {
+        auto path = MatrixTextFile("lch_matrix_read.txt",
+                                   "\n1.5 -2\t+3e2\r\n  \n4 5.25 -0\n\n");
+        auto matrix = LCH::Matrix<double>::ReadFromFile(path);
+        REQUIRE(matrix.Rows() == 2);
+        REQUIRE(matrix.Cols() == 3);
+        CHECK(matrix(0, 0) == 1.5);
+        CHECK(matrix(0, 2) == 300);
+        CHECK(matrix(1, 1) == 5.25);
+
+        MatrixTextFile("lch_matrix_read.txt", "1 2\n3 4");
+        CHECK(LCH::Matrix<int>::ReadFromFile(path)(1, 1) == 4);
+        MatrixTextFile("lch_matrix_read.txt", "a b\nc d\n");
+        CHECK(LCH::Matrix<char>::ReadFromFile(path)(1, 0) == 'c');
+        MatrixTextFile("lch_matrix_read.txt", "");
+        auto empty = LCH::Matrix<int>::ReadFromFile(path);
+        CHECK(empty.Rows() == 0);
+        CHECK(empty.Cols() == 0);
+        MatrixTextFile("lch_matrix_read.txt", "-1");
+        CHECK_THROWS_AS(LCH::Matrix<unsigned>::ReadFromFile(path),
+                        std::runtime_error);
+        LCH::File::remove(path);
+    }
+
+    SECTION("bad input") {
+        auto ragged = MatrixTextFile("lch_matrix_read_ragged.txt",
+                                     "1 2\n3 4\n5\n");
+        CHECK_THROWS_WITH(LCH::Matrix<int>::ReadFromFile(ragged),
+                          Catch::Contains("at line 3"));
+        auto wrong = MatrixTextFile("lch_matrix_read_wrong.txt",
+                                    "1 2\n3 x4\n");
+        CHECK_THROWS_WITH(LCH::Matrix<int>::ReadFromFile(wrong),
+                          Catch::Contains("\"x4\" at line 2"));
+        CHECK_THROWS_AS(LCH::Matrix<int>::ReadFromFile(
+                LCH::File::temp_directory_path() / "lch_matrix_missing.txt"),
+                std::runtime_error);
+        LCH::File::remove(ragged);
+        LCH::File::remove(wrong);
+    }
+
+    SECTION("big files in parallel") {
+        std::mt19937 rng(48);
+        auto expected = RandomMatrix<float>(rng, 40000, 20);
+        std::ostringstream text;
+        text << expected << '\n';
+        auto path = MatrixTextFile("lch_matrix_read_big.txt", text.str());
+        LCH::ThreadPool pool(3);
+        CHECK(SameMatrix(LCH::Matrix<float>::ReadFromFile(path, &pool),
+                         expected));
+        CHECK(SameMatrix(LCH::Matrix<float>::ReadFromFile(path), expected));
+
+        auto broken = text.str();
+        broken[broken.size()*3/4] = '?';
+        auto brokenPath = MatrixTextFile("lch_matrix_read_broken.txt", broken);
+        CHECK_THROWS_AS(LCH::Matrix<float>::ReadFromFile(brokenPath, &pool),
+                        std::runtime_error);
+        LCH::File::remove(path);
+        LCH::File::remove(brokenPath);
+    }
+}
+
+TEST_CASE("Binary matrix files", "[matrix]") {
+    std::mt19937 rng(49);
+    auto path = LCH::File::temp_directory_path() / "lch_matrix_binary.bin";
+
+    SECTION("round trips are exact") {
+        LCH::Matrix<double> matrix(37, 23);
+        std::uniform_real_distribution<double> value(-1e6, 1e6);
+        for (auto row : matrix) {
+            for (double& x : row) x = value(rng);
+        }
+        matrix.WriteBinary(path);
+        CHECK(LCH::File::file_size(path) == 64 + 37*23*sizeof(double));
+        CHECK(SameMatrix(LCH::Matrix<double>::ReadBinary(path), matrix));
+
+        LCH::MappedMatrix<double> mapped(path);
+        REQUIRE(mapped.Rows() == 37);
+        REQUIRE(mapped.Cols() == 23);
+        CHECK(reinterpret_cast<std::uintptr_t>(mapped.Data()) % 64 == 0);
+        CHECK(mapped(36, 22) == matrix(36, 22));
+        CHECK(mapped.Row(5)[7] == matrix(5, 7));
+        CHECK((*(mapped.begin() + 2))[1] == matrix(2, 1));
+        CHECK_THROWS_AS(mapped(37, 0), std::out_of_range);
+        CHECK(SameMatrix(LCH::Matrix<double>(mapped), matrix));
+        LCH::Matrix<double> doubled = mapped*2.0 - matrix;
+        CHECK(SameMatrix(doubled, matrix));
+        auto square = RandomMatrix<double>(rng, 23, 23);
+        CHECK(SameMatrix(mapped*square, matrix*square));
+
+        LCH::Matrix<std::int16_t> small(2, 3);
+        small(1, 2) = -300;
+        small.WriteBinary(path);
+        CHECK(SameMatrix(LCH::Matrix<std::int16_t>::ReadBinary(path), small));
+        LCH::Matrix<float> empty(0, 4);
+        empty.WriteBinary(path);
+        CHECK(LCH::MappedMatrix<float>(path).Cols() == 4);
+    }
+
+    SECTION("files from the other byte order can be read but not mapped") {
+        LCH::Matrix<std::uint32_t> matrix(3, 2);
+        matrix(2, 1) = 0x11223344;
+        matrix.WriteBinary(path);
+        std::string bytes;
+        {
+            std::ifstream in(path.native(), std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in),
+                         std::istreambuf_iterator<char>());
+        }
+        // every field but the magic is 4 or 8 bytes wide
+        for (std::size_t i = 8; i < 24; i += 4) {
+            std::reverse(bytes.begin() + i, bytes.begin() + i + 4);
+        }
+        for (std::size_t i = 24; i < 48; i += 8) {
+            std::reverse(bytes.begin() + i, bytes.begin() + i + 8);
+        }
+        for (std::size_t i = 64; i < bytes.size(); i += 4) {
+            std::reverse(bytes.begin() + i, bytes.begin() + i + 4);
+        }
+        MatrixTextFile("lch_matrix_binary.bin", bytes);
+        CHECK(SameMatrix(LCH::Matrix<std::uint32_t>::ReadBinary(path),
+                         matrix));
+        CHECK_THROWS_AS(LCH::MappedMatrix<std::uint32_t>(path),
+                        std::runtime_error);
+    }
+
+    SECTION("bad files") {
+        LCH::Matrix<float> matrix(4, 4);
+        matrix.WriteBinary(path);
+        CHECK_THROWS_AS(LCH::Matrix<double>::ReadBinary(path),
+                        std::runtime_error);
+        CHECK_THROWS_AS(LCH::MappedMatrix<std::int32_t>(path),
+                        std::runtime_error);
+
+        LCH::File::resize_file(path, 64 + 15*sizeof(float));
+        CHECK_THROWS_AS(LCH::Matrix<float>::ReadBinary(path),
+                        std::runtime_error);
+        CHECK_THROWS_AS(LCH::MappedMatrix<float>(path), std::runtime_error);
+
+        MatrixTextFile("lch_matrix_binary.bin", "1 2\n3 4\n");
+        CHECK_THROWS_AS(LCH::Matrix<float>::ReadBinary(path),
+                        std::runtime_error);
+        CHECK_THROWS_AS(LCH::MappedMatrix<float>(path), std::runtime_error);
+        CHECK_THROWS_AS(LCH::Matrix<float>::ReadBinary(
+                LCH::File::temp_directory_path() / "lch_matrix_missing.bin"),
+                std::runtime_error);
+    }
+    LCH::File::remove(path);
+}
+
+TEST_CASE("Writing matrices as text", "[matrix]") {
+    LCH::Matrix<double> matrix(2, 3);
+    matrix(0, 0) = 0.1;
+    matrix(0, 1) = -250;
+    matrix(1, 1) = 1e-20;
+    matrix(1, 2) = 3;
+
+    SECTION("plain and aligned text") {
+        CHECK(matrix.ToText() == "0.1 -250 0\n0 1e-20 3\n");
+        CHECK(matrix.ToText(true) == "0.1  -250 0\n"
+                                     "  0 1e-20 3\n");
+        std::ostringstream os;
+        os << matrix;
+        CHECK(os.str() == "0.1 -250 0\n0 1e-20 3");
+
+        LCH::Matrix<std::string> words(2, 2);
+        words(0, 0) = "a";
+        words(1, 0) = "bcd";
+        CHECK(words.ToText(true) == "  a \nbcd \n");
+        CHECK(LCH::Matrix<int>(0, 3).ToText(true).empty());
+        CHECK(LCH::Matrix<int>(2, 0).ToText() == "\n\n");
+        std::ostringstream none;
+        none << LCH::Matrix<int>(0, 0);
+        CHECK(none.str().empty());
+    }
+
+    SECTION("files read back exactly") {
+        std::mt19937 rng(50);
+        LCH::Matrix<double> big(3000, 40);
+        std::normal_distribution<double> value(0, 1e3);
+        for (auto row : big) {
+            for (double& x : row) x = value(rng);
+        }
+        auto path = LCH::File::temp_directory_path() / "lch_matrix_write.txt";
+        for (bool aligned : {false, true}) {
+            big.WriteToFile(path, aligned);
+            CHECK(SameMatrix(LCH::Matrix<double>::ReadFromFile(path), big));
+        }
+        CHECK(big.ToText(true).size() == LCH::File::file_size(path));
+        LCH::File::remove(path);
+    }
+}
@@ -0,0 +1,241 @@
+#include "reclamation.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2018-2019 by Joyz Inc of Tokyo, Japan (author: Charles Hussong) //
+//                                                                           //
+// Licensed under the Apache License, Version 2.0 (the "License");           //
+// you may not use this file except in compliance with the License.          //
+// You may obtain a copy of the License at                                   //
+//                                                                           //
+//    http://www.apache.org/licenses/LICENSE-2.0                             //
+//                                                                           //
+// Unless required by applicable law or agreed to in writing, software       //
+// distributed under the License is distributed on an "AS IS" BASIS,         //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  //
+// See the License for the specific language governing permissions and       //
+// limitations under the License.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Catch2/catch.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class CountedNode {
+  public:
+    explicit CountedNode(int value): value(value) { alive += 1; }
+    ~CountedNode() { alive -= 1; }
+
+    static int Alive() { return alive; }
+
+    int value;
+
+  private:
+    static std::atomic<int> alive;
+};
+
+std::atomic<int> CountedNode::alive{0};
+
+TEST_CASE("EpochDomain frees retired pointers only after readers unpin",
+          "[reclamation]") {
+    REQUIRE(CountedNode::Alive() == 0);
+
+    SECTION("nothing pinned") {
+        LCH::EpochDomain domain;
+        domain.Retire(new CountedNode(1));
+        REQUIRE(CountedNode::Alive() == 1);
+        for (int i = 0; i < 3; ++i) domain.Collect();
+        REQUIRE(CountedNode::Alive() == 0);
+    }
+
+    SECTION("pinned by this thread") {
+        LCH::EpochDomain domain;
+        {
+            auto guard = domain.Pin();
+            auto nested = domain.Pin();
+            domain.Retire(new CountedNode(1));
+            for (int i = 0; i < 3; ++i) domain.Collect();
+            REQUIRE(CountedNode::Alive() == 1);
+        }
+        for (int i = 0; i < 3; ++i) domain.Collect();
+        REQUIRE(CountedNode::Alive() == 0);
+    }
+
+    SECTION("pinned by another thread, which then exits") {
+        LCH::EpochDomain domain;
+        std::atomic<int> stage{0};
+        std::thread reader([&](){
+            auto guard = domain.Pin();
+            stage = 1;
+            while (stage != 2) std::this_thread::yield();
+            domain.Retire(new CountedNode(2));
+        });
+        while (stage != 1) std::this_thread::yield();
+        domain.Retire(new CountedNode(1));
+        for (int i = 0; i < 3; ++i) domain.Collect();
+        REQUIRE(CountedNode::Alive() == 1);
+        stage = 2;
+        reader.join();
+        // the exited thread's retirement is handed over to the domain
+        for (int i = 0; i < 3; ++i) domain.Collect();
+        REQUIRE(CountedNode::Alive() == 0);
+    }
+
+    SECTION("batches are freed automatically, the rest at destruction") {
+        {
+            LCH::EpochDomain domain(4);
+            for (int i = 0; i < 100; ++i) domain.Retire(new CountedNode(i));
+            REQUIRE(CountedNode::Alive() < 100);
+            auto guard = domain.Pin();
+            domain.Retire(new CountedNode(-1));
+        }
+        REQUIRE(CountedNode::Alive() == 0);
+    }
+}
+
+TEST_CASE("HazardPointerDomain keeps protected pointers alive",
+          "[reclamation]") {
+    REQUIRE(CountedNode::Alive() == 0);
+    LCH::HazardPointerDomain domain;
+    std::atomic<CountedNode*> head{new CountedNode(1)};
+
+    {
+        LCH::HazardPointerDomain::Holder hazard(domain);
+        CountedNode* node = hazard.Protect(head);
+        REQUIRE(node->value == 1);
+
+        domain.Retire(head.exchange(new CountedNode(2)));
+        domain.Collect();
+        REQUIRE(node->value == 1);
+        REQUIRE(CountedNode::Alive() == 2);
+
+        hazard.Reset();
+        domain.Collect();
+        REQUIRE(CountedNode::Alive() == 1);
+    }
+
+    std::vector<std::unique_ptr<LCH::HazardPointerDomain::Holder>> holders;
+    for (std::size_t i = 0; i < LCH::HazardPointerDomain::slotsPerThread; ++i) {
+        holders.push_back(
+                std::make_unique<LCH::HazardPointerDomain::Holder>(domain));
+    }
+    REQUIRE_THROWS_AS(LCH::HazardPointerDomain::Holder(domain),
+                      std::length_error);
+    holders.clear();
+
+    domain.Retire(head.exchange(nullptr));
+    domain.Collect();
+    REQUIRE(CountedNode::Alive() == 0);
+}
+
+// Retires two more nodes to the same domain when it's destroyed.
+template<class Domain>
+class RetiringNode {
+  public:
+    explicit RetiringNode(Domain& domain): domain(domain) {}
+    ~RetiringNode() {
+        domain.Retire(new CountedNode(0));
+        domain.Retire(new CountedNode(1));
+    }
+
+  private:
+    Domain& domain;
+};
+
+template<class Domain>
+void CheckRetiringFromDeleters() {
+    SECTION("freed by Collect") {
+        Domain domain(4);
+        for (int i = 0; i < 100; ++i) {
+            domain.Retire(new RetiringNode<Domain>(domain));
+        }
+        for (int i = 0; i < 6; ++i) domain.Collect();
+        REQUIRE(CountedNode::Alive() == 0);
+    }
+
+    SECTION("freed by the domain's destructor") {
+        {
+            Domain domain(1000);
+            for (int i = 0; i < 100; ++i) {
+                domain.Retire(new RetiringNode<Domain>(domain));
+            }
+        }
+        REQUIRE(CountedNode::Alive() == 0);
+    }
+}
+
+TEST_CASE("deleters can retire more pointers to the same domain",
+          "[reclamation]") {
+    REQUIRE(CountedNode::Alive() == 0);
+
+    SECTION("epochs") {
+        CheckRetiringFromDeleters<LCH::EpochDomain>();
+    }
+
+    SECTION("hazard pointers") {
+        CheckRetiringFromDeleters<LCH::HazardPointerDomain>();
+    }
+}
+
+TEST_CASE("reclamation domains survive concurrent readers and writers",
+          "[reclamation]") {
+    REQUIRE(CountedNode::Alive() == 0);
+    constexpr int writes = 2000;
+
+    SECTION("epochs") {
+        LCH::EpochDomain domain(16);
+        std::atomic<CountedNode*> head{new CountedNode(0)};
+        std::atomic<bool> done{false};
+        std::atomic<bool> wentBackwards{false};
+
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 3; ++t) {
+            readers.emplace_back([&](){
+                int last = 0;
+                while (!done) {
+                    auto guard = domain.Pin();
+                    int value = head.load(std::memory_order_acquire)->value;
+                    if (value < last) wentBackwards = true;
+                    last = value;
+                }
+            });
+        }
+        for (int i = 1; i <= writes; ++i) {
+            domain.Retire(head.exchange(new CountedNode(i)));
+        }
+        done = true;
+        for (auto& reader : readers) reader.join();
+        delete head.load();
+        REQUIRE(!wentBackwards);
+    }
+
+    SECTION("hazard pointers") {
+        LCH::HazardPointerDomain domain(16);
+        std::atomic<CountedNode*> head{new CountedNode(0)};
+        std::atomic<bool> done{false};
+        std::atomic<bool> wentBackwards{false};
+
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 3; ++t) {
+            readers.emplace_back([&](){
+                LCH::HazardPointerDomain::Holder hazard(domain);
+                int last = 0;
+                while (!done) {
+                    int value = hazard.Protect(head)->value;
+                    if (value < last) wentBackwards = true;
+                    last = value;
+                }
+            });
+        }
+        for (int i = 1; i <= writes; ++i) {
+            domain.Retire(head.exchange(new CountedNode(i)));
+        }
+        done = true;
+        for (auto& reader : readers) reader.join();
+        delete head.load();
+        REQUIRE(!wentBackwards);
+    }
+
+    REQUIRE(CountedNode::Alive() == 0);
+}